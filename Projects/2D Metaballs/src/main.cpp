@@ -65,7 +65,8 @@ int main()
 			
 			context.GetDescriptorSetCache()->SetResource(descriptorSetKey, "circles", &circles[0], sizeof(Circle) * 3);
 			
-			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), context.GetSwapchainExtent(), VertexAttributes{}, DepthSettings::Disabled(), { BlendSettings::Mixed() }, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			const auto blend = BlendSettings::Mixed();
+			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), VertexAttributes{}, DepthSettings::Disabled(), &blend, 1, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
 				descriptorSetKey.program);
 
 			context.GetDescriptorSetCache()->BindDescriptorSet(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, descriptorSetKey);
@@ -82,6 +83,6 @@ int main()
 
 	vkDeviceWaitIdle(*renderer->GetDevice());
 
-	delete program;
+	renderer->GetShaderManager()->releaseProgram(program);
 	delete gui.key.program;
 }
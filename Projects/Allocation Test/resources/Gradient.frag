@@ -0,0 +1,16 @@
+#version 450 core
+
+layout(location = 0) out vec4 fColor;
+
+layout(binding = 0) uniform i
+{
+    float time;
+    float padding0;
+    float padding1;
+    float padding2;
+} info;
+
+void main() 
+{
+    fColor = vec4(fract(gl_FragCoord.xy / 256.0), 0.5 + 0.5 * sin(info.time), 1.0);
+}
@@ -0,0 +1,133 @@
+// Renders headless and counts every global operator new over a run of frames once everything has warmed up. A steady
+// frame shouldn't allocate, anything above zero is a regression somewhere on the record or bind path. Runs without a
+// GPU on lavapipe, VK_ICD_FILENAMES pointing at lvp_icd.*.json, and exits non-zero when something allocated.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "Renderer/Core.h"
+#include "Renderer/RenderGraph/GraphContext.h"
+#include "Renderer/RenderGraph/PassDesc.h"
+
+using namespace Renderer;
+
+static std::atomic<bool> counting = false;
+static std::atomic<uint64_t> allocations = 0;
+
+// Every form of operator new goes through here, aligned or not, so any operator delete can free any of them. The block
+// malloc returned is kept just before the one handed out
+static void* Allocate(size_t size, size_t alignment)
+{
+	if (counting) ++allocations;
+
+	auto* raw = static_cast<char*>(std::malloc(size + alignment + sizeof(void*)));
+	if (!raw) return nullptr;
+
+	const auto address = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+	auto* memory = reinterpret_cast<void**>((address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+	memory[-1] = raw;
+
+	return memory;
+}
+
+static void Free(void* memory)
+{
+	if (memory) std::free(static_cast<void**>(memory)[-1]);
+}
+
+static void* AllocateOrThrow(size_t size, size_t alignment)
+{
+	if (auto* memory = Allocate(size, alignment)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[](size_t size) { return AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return Allocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return Allocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* memory) noexcept { Free(memory); }
+void operator delete[](void* memory) noexcept { Free(memory); }
+void operator delete(void* memory, size_t) noexcept { Free(memory); }
+void operator delete[](void* memory, size_t) noexcept { Free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { Free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { Free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { Free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { Free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { Free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { Free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { Free(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { Free(memory); }
+
+struct Information
+{
+	float time;
+	float padding[3]; // Matches the three floats after time in Gradient.frag
+};
+
+static constexpr uint32_t warmupFrames = 16;
+static constexpr uint32_t measuredFrames = 1000;
+
+int main()
+{
+	Settings s = {};
+	s.width = 640;
+	s.height = 480;
+	s.headless = true;
+	s.headlessFrames = warmupFrames + measuredFrames;
+
+	auto renderer = std::make_unique<Core>(s);
+	renderer->Initialise();
+
+	auto* shaderManager = renderer->GetShaderManager();
+	auto program = shaderManager->getProgram({ shaderManager->fullScreenTri(), shaderManager->get(ShaderType::Fragment, "resources/Gradient.frag") });
+	program->InitialiseResources(renderer->GetDevice()->GetDevice());
+
+	DescriptorSetKey descriptorSetKey = { program };
+	auto info = Information{};
+
+	auto* graph = renderer->GetRenderGraph();
+	auto* graphicsCache = renderer->GetGraphicsPipelineCache();
+	auto* descriptorCache = renderer->GetDescriptorSetCache();
+
+	graph->AddPass("Gradient", QueueType::Graphics)
+		.AddWrittenImage(graph->GetBackBuffer(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, {})
+		.SetRecordFunc([&](VkCommandBuffer buffer, const FrameInfo& frameInfo, GraphContext& context)
+		{
+			info.time += 1.0f / 60.0f;
+			descriptorCache->SetResource(descriptorSetKey, "info", &info, sizeof(Information));
+
+			const auto blend = BlendSettings::Mixed();
+			const auto key = graphicsCache->CreateKey(context, VertexAttributes{}, DepthSettings::Disabled(), &blend, 1, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, program);
+			if (!graphicsCache->BindGraphicsPipeline(buffer, key)) return;
+
+			descriptorCache->BindDescriptorSet(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, descriptorSetKey);
+
+			vkCmdDraw(buffer, 3, 1, 0, 0);
+		});
+
+	graph->Build();
+
+	uint32_t frame = 0;
+	while (renderer->Run())
+	{
+		counting = frame++ >= warmupFrames;
+		graph->Execute();
+	}
+
+	counting = false;
+	vkDeviceWaitIdle(*renderer->GetDevice());
+
+	shaderManager->releaseProgram(program);
+
+	std::printf("%llu allocations over %u frames\n", static_cast<unsigned long long>(allocations.load()), measuredFrames);
+
+	return allocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,118 @@
+// Bind path lookups against a cache of 10k+ entries, the node based std::unordered_map the caches used to sit on
+// against FlatMap and Cache as they are now. Nothing touches the GPU, build it in Release and compare ns per lookup.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "Renderer/VulkanObjects/Cache.h"
+#include "Renderer/VulkanObjects/FlatMap.h"
+
+using namespace Renderer;
+
+// Shaped like a DescriptorSetKey, a program pointer and a signature of what's bound
+struct BindKey
+{
+	const void* program;
+	uint64_t signature;
+
+	bool operator ==(const BindKey& other) const { return program == other.program && signature == other.signature; }
+};
+
+namespace std
+{
+	template <>
+	struct hash<BindKey>
+	{
+		size_t operator()(const BindKey& s) const noexcept
+		{
+			size_t h1 = hash<uint64_t>{}(reinterpret_cast<uint64_t>(s.program));
+			h1 ^= hash<uint64_t>{}(s.signature) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+
+			return h1;
+		}
+	};
+}
+
+struct Value
+{
+	uint64_t payload;
+};
+
+class BenchCache : public Cache<Value, BindKey>
+{
+public:
+	Value* Get(const BindKey& key) override { return FindOrEmplace(key, Value{ key.signature }); }
+
+	bool Add(const BindKey& key) override
+	{
+		if (cache.Contains(key)) return false;
+
+		Emplace(key, Value{ key.signature });
+		return true;
+	}
+
+private:
+	void ClearEntry(Value*) override { }
+};
+
+template <class Lookup>
+double Measure(const std::vector<BindKey>& lookups, Lookup lookup)
+{
+	uint64_t sum = 0;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (const auto& key : lookups) sum += lookup(key);
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	// Keeps the lookups from being optimised out
+	if (sum == 42) printf(" ");
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / lookups.size();
+}
+
+int main()
+{
+	constexpr size_t lookupCount = 4'000'000;
+	constexpr size_t programCount = 256;
+
+	std::mt19937_64 random(1234);
+
+	// Programs come from one arena, so their addresses sit close together like the real ones
+	auto programs = std::vector<uint8_t>(programCount * 512);
+
+	printf("%10s %18s %12s %12s\n", "entries", "unordered_map ns", "FlatMap ns", "Cache ns");
+
+	for (size_t entries : { 10'000, 50'000, 100'000, 500'000 })
+	{
+		auto keys = std::vector<BindKey>();
+		for (size_t i = 0; i < entries; i++) keys.push_back({ &programs[(i % programCount) * 512], random() });
+
+		auto lookups = std::vector<BindKey>();
+		auto pick = std::uniform_int_distribution<size_t>(0, entries - 1);
+		for (size_t i = 0; i < lookupCount; i++) lookups.push_back(keys[pick(random)]);
+
+		// What Cache used to be, a node per entry and a new per value
+		auto nodeMap = std::unordered_map<BindKey, std::unique_ptr<Value>>();
+		for (const auto& key : keys) nodeMap.emplace(key, std::make_unique<Value>(Value{ key.signature }));
+
+		auto flatMap = FlatMap<BindKey, Value>();
+		for (const auto& key : keys) *flatMap.TryEmplace(key).first = Value{ key.signature };
+
+		auto cache = BenchCache();
+		for (const auto& key : keys) cache.Add(key);
+
+		const auto nodeTime = Measure(lookups, [&](const BindKey& key) { return nodeMap.find(key)->second->payload; });
+		const auto flatTime = Measure(lookups, [&](const BindKey& key) { return flatMap.Find(key)->payload; });
+		const auto cacheTime = Measure(lookups, [&](const BindKey& key) { return cache.Get(key)->payload; });
+
+		printf("%10zu %18.2f %12.2f %12.2f\n", entries, nodeTime, flatTime, cacheTime);
+
+		cache.ClearCache();
+	}
+
+	return 0;
+}
@@ -3,6 +3,7 @@
 
 
 #include <imgui.h>
+#include <glfw3.h>
 
 #include "Renderer/Core.h"
 #include "Renderer/RenderGraph/GraphContext.h"
@@ -11,7 +12,7 @@
 using namespace Renderer;
 
 
-void GameOfLife(RenderGraph* graph, bool bloom = true);
+void GameOfLife(RenderGraph* graph, const bool& bloom);
 
 enum class ProgramState { GameOfLife, WireWorld, GameOfLife3D, Elementary, BriansBrain, LangstonsAnt };
 
@@ -30,13 +31,21 @@ int main()
 
 	auto* graph = core->GetRenderGraph();
 
-	GameOfLife(graph, false);
+	bool bloom = false;
+	GameOfLife(graph, bloom);
 	core->AddGuiPass();
 
 	graph->Build();
+
+	bool bloomKey = false;
 	
 	while (core->Run())
 	{
+		// B toggles the bloom passes, no rebuild needed
+		const bool pressed = glfwGetKey(core->GetSwapchain()->GetWindow(), GLFW_KEY_B) == GLFW_PRESS;
+		if (pressed && !bloomKey) bloom = !bloom;
+		bloomKey = pressed;
+
 		//if (ImGui::Button("Game Of Life"))
 		//{
 		//	if (state != ProgramState::GameOfLife)
@@ -55,7 +64,7 @@ int main()
 	
 }
 
-void GameOfLife(RenderGraph* graph, bool bloom)
+void GameOfLife(RenderGraph* graph, const bool& bloom)
 {
 	//static Shader* fragment = Utility::Shader::Get(ShaderType::Fragment, "resources/GameOfLife.frag");
 	//static Shader* compute = Utility::Shader::Get(ShaderType::Compute, "resources/GameOfLife.comp");
@@ -75,18 +84,26 @@ void GameOfLife(RenderGraph* graph, bool bloom)
 
 	graph->AddPass("Fragment GOL", QueueType::Graphics)
 			.AddReadImage("compute-gol", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
-			.AddWrittenImage(bloom ? "fragment-gol" : graph->GetBackBuffer(),VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT, {})
+			.AddWrittenImage("fragment-gol",VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT, {})
 			.SetRecordFunc([&](VkCommandBuffer buffer, const FrameInfo& frameInfo, GraphContext& context)
 			{
 				// Full Screen tri, render from image received from compute
 			});
 
-	if(!bloom) return;
+	graph->AddPass("Output GOL", QueueType::Graphics)
+			.AddReadImage("fragment-gol", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+			.AddWrittenImage(graph->GetBackBuffer(),VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT, {})
+			.SetEnableFunc([&bloom] { return !bloom; })
+			.SetRecordFunc([&](VkCommandBuffer buffer, const FrameInfo& frameInfo, GraphContext& context)
+			{
+				// Copy straight to the backbuffer
+			});
 	
 	// Bloom
 	graph->AddPass("Bloom-Colour GOL", QueueType::Graphics)
 			.AddReadImage("fragment-gol", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
 			.AddWrittenImage("bloom-colour",VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT, {})
+			.SetEnableFunc([&bloom] { return bloom; })
 			.SetRecordFunc([&](VkCommandBuffer buffer, const FrameInfo& frameInfo, GraphContext& context)
 			{
 				// Colour
@@ -95,6 +112,7 @@ void GameOfLife(RenderGraph* graph, bool bloom)
 	graph->AddPass("Bloom-Blur GOL", QueueType::Graphics)
 			.AddReadImage("bloom-colour", VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
 			.AddWrittenImage("bloom-blur", VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT, {})
+			.SetEnableFunc([&bloom] { return bloom; })
 			.SetRecordFunc([&](VkCommandBuffer buffer, const FrameInfo& frameInfo, GraphContext& context)
 			{
 				// Blur
@@ -104,6 +122,7 @@ void GameOfLife(RenderGraph* graph, bool bloom)
 			.AddReadImage("fragment-gol", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
 			.AddReadImage("bloom-blur", VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
 			.AddWrittenImage(graph->GetBackBuffer(),VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT, {})
+			.SetEnableFunc([&bloom] { return bloom; })
 			.SetRecordFunc([&](VkCommandBuffer buffer, const FrameInfo& frameInfo, GraphContext& context)
 			{
 				// Final output
@@ -80,14 +80,15 @@ int main()
 				ImGui::End();
 			}
 
-			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), context.GetSwapchainExtent(), vert, DepthSettings::Disabled(), { BlendSettings::Add() }, VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+			const auto blend = BlendSettings::Add();
+			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), vert, DepthSettings::Disabled(), &blend, 1, VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
 				descriptorSetKey.program);
 
 			context.GetDescriptorSetCache()->BindDescriptorSet(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, descriptorSetKey);
 
 			sp->Draw(buffer);
 
-			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), context.GetSwapchainExtent(), vert, DepthSettings::Disabled(), { BlendSettings::Add() }, VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
+			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), vert, DepthSettings::Disabled(), &blend, 1, VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
 				descriptorSetKey.program);
 
 			context.GetDescriptorSetCache()->BindDescriptorSet(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, descriptorSetKey);
@@ -106,5 +107,5 @@ int main()
 
 	sp->Cleanup();
 	delete sp;
-	delete program;
+	renderer->GetShaderManager()->releaseProgram(program);
 }
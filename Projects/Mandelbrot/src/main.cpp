@@ -59,5 +59,5 @@ int main()
 
 	vkDeviceWaitIdle(*renderer->GetDevice());
 
-	delete program;
+	renderer->GetShaderManager()->releaseProgram(program);
 }
@@ -62,7 +62,8 @@ int main()
 			
 			context.GetDescriptorSetCache()->SetResource(descriptorSetKey, "info", &info, sizeof(Information));
 
-			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), context.GetSwapchainExtent(), VertexAttributes{}, DepthSettings::Disabled(), { BlendSettings::Mixed() }, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			const auto blend = BlendSettings::Mixed();
+			context.GetGraphicsPipelineCache()->BindGraphicsPipeline(buffer, context.GetDefaultRenderpass(), VertexAttributes{}, DepthSettings::Disabled(), &blend, 1, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
 				descriptorSetKey.program);
 
 			context.GetDescriptorSetCache()->BindDescriptorSet(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, descriptorSetKey);
@@ -79,5 +80,5 @@ int main()
 
 	vkDeviceWaitIdle(*renderer->GetDevice());
 
-	delete program;
+	renderer->GetShaderManager()->releaseProgram(program);
 }
@@ -179,6 +179,8 @@ CreateProject("2D Metaballs")
 CreateProject("Quasicrystals")
 CreateProject("Cellular Automata")
 CreateProject("Mandelbrot")
+CreateProject("Cache Benchmark")
+CreateProject("Allocation Test") -- Headless, runs on lavapipe where there's no GPU
 
 group ""
 
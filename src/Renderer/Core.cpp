@@ -5,6 +5,7 @@
 #include "examples/imgui_impl_vulkan.h"
 #include "examples/imgui_impl_glfw.h"
 #include "Memory/Allocator.h"
+#include <algorithm>
 
 namespace Renderer
 {
@@ -132,28 +133,103 @@ namespace Renderer
 			This will initialise the (mostly) static states of the renderer, customisation can come later.
 		*/
 		swapchain.Initialise(device.GetDevice(), device.GetInstance(), device.GetPhysicalDevice());
+		swapchain.SetFramesInFlight(static_cast<uint32_t>(settings.buffering)); // SwapchainSync is 0, which follows the image count
 
-		swapchain.BuildWindow(settings.width, settings.height, settings.name);
+		if (settings.headless)
+		{
+#ifdef NDEBUG
+			device.BuildInstance(false, true);
+#elif DEBUG
+			device.BuildInstance(true, true);
+#endif
+			device.PickPhysicalDevice(nullptr);
+			RequestDeviceFeatures();
+			device.BuildLogicalDevice(swapchain.GetPresentQueue());
+
+			// There are no swapchain images to follow
+			if (settings.buffering == RendererBufferSettings::SwapchainSync) swapchain.SetFramesInFlight(3);
+
+			allocator = new Memory::Allocator(GetDevice(), GetSwapchain()->GetFramesInFlight());
+
+			swapchain.BuildHeadless(allocator, settings.width, settings.height);
+			swapchain.BuildSyncObjects();
+		}
+		else
+		{
+			swapchain.BuildWindow(settings.width, settings.height, settings.name);
 
 #ifdef NDEBUG
-		device.BuildInstance(false);
+			device.BuildInstance(false);
 #elif DEBUG
-		device.BuildInstance(true);
+			device.BuildInstance(true);
 #endif
-		swapchain.BuildSurface();
-		device.PickPhysicalDevice(swapchain.GetSurface());
-		device.BuildLogicalDevice(swapchain.GetPresentQueue());
+			swapchain.BuildSurface();
+			device.PickPhysicalDevice(swapchain.GetSurface());
+			RequestDeviceFeatures();
+			device.BuildLogicalDevice(swapchain.GetPresentQueue());
 
-		swapchain.BuildSwapchain(settings.vsync);
-		swapchain.BuildSyncObjects();
+			swapchain.BuildSwapchain(settings.vsync);
+			swapchain.BuildSyncObjects();
 
-		allocator = new Memory::Allocator(GetDevice(), GetSwapchain()->GetFramesInFlight());
+			allocator = new Memory::Allocator(GetDevice(), GetSwapchain()->GetFramesInFlight());
+		}
+
+		pipelineCache.Load(&device, settings.pipelineCachePath);
 
-		framebufferCache.BuildCache(device.GetDevice(), swapchain.GetFramesInFlight());
+		framebufferCache.BuildCache(device.GetDevice(), device.IsImagelessFramebufferEnabled());
 		renderpassCache.BuildCache(device.GetDevice());
-		graphicsPipelineCache.BuildCache(device.GetDevice());
-		descriptorCache.BuildCache(device.GetDevice(), allocator, swapchain.GetFramesInFlight());
-		shaderManager = new ShaderManager(device.GetDevice());
+		graphicsPipelineCache.BuildCache(device.GetDevice(), pipelineCache);
+		graphicsPipelineCache.SetExtendedDynamicState(device.GetExtendedDynamicState());
+		computePipelineCache.BuildCache(device.GetDevice(), pipelineCache);
+		if (settings.pipelineCompileThreads > 0)
+		{
+			pipelineCompiler = std::make_unique<PipelineCompiler>(&pipelineCache, settings.pipelineCompileThreads);
+			graphicsPipelineCache.SetCompiler(pipelineCompiler.get());
+		}
+		descriptorAllocator.Initialise(device.GetDevice(), swapchain.GetFramesInFlight());
+		const auto& limits = device.GetPhysicalDeviceProperties().limits;
+		uniformStream.Initialise(allocator, std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment), settings.uniformStreamSize, swapchain.GetFramesInFlight());
+		samplerCache.BuildCache(device.GetDevice(), limits.maxSamplerAllocationCount);
+		setLayoutCache.BuildCache(device.GetDevice());
+		pipelineLayoutCache.BuildCache(device.GetDevice(), &setLayoutCache, limits.maxBoundDescriptorSets);
+		descriptorCache.BuildCache(device.GetDevice(), allocator, &descriptorAllocator, &uniformStream, &samplerCache, swapchain.GetFramesInFlight());
+		descriptorCache.SetPushDescriptorSet(device.GetPushDescriptorSet());
+
+		// Renderpasses and layouts are left alone, pipelines and framebuffers hold on to their handles
+		const auto defer = [this](std::function<void()> cleanup) { allocator->Defer([cleanup](VkDevice) { cleanup(); }); };
+		framebufferCache.SetEviction(settings.cacheMaxAge, settings.cacheBudget, defer);
+		graphicsPipelineCache.SetEviction(settings.cacheMaxAge, settings.cacheBudget, defer);
+		descriptorCache.SetEviction(settings.cacheMaxAge, settings.cacheBudget, defer);
+		samplerCache.SetEviction(settings.cacheMaxAge, settings.cacheBudget, defer);
+		shaderManager = new ShaderManager(device.GetDevice(), &pipelineLayoutCache);
+		shaderManager->SetPushDescriptors(descriptorCache.IsPushDescriptorEnabled());
+
+		// Pipelines and descriptor sets are keyed by program, they go with it
+		shaderManager->SetRetire([this, defer](ShaderProgram* program)
+		{
+			if (!graphicsPipelineCache.RetireProgram(program, defer)) return false;
+
+			computePipelineCache.RetireProgram(program, defer);
+			descriptorCache.RetireProgram(program, defer);
+			return true;
+		}, defer);
+
+		if (device.IsDescriptorIndexingEnabled())
+		{
+			bindlessHeap = std::make_unique<BindlessHeap>(&device, allocator, &pipelineLayoutCache);
+			shaderManager->SetBindlessLayout(bindlessHeap->GetLayout());
+
+			// The heap pushes every frequency up a set, the Draw set needs a fifth
+			if (limits.maxBoundDescriptorSets <= BindlessHeap::set + static_cast<uint32_t>(SetFrequency::Count))
+				LogWarning("Device binds {} descriptor sets, bindless programs can't declare a Draw set", limits.maxBoundDescriptorSets);
+		}
+
+		pipelineManifest.Load(settings.pipelineManifestPath, &renderpassCache, shaderManager);
+		if (!settings.pipelineManifestPath.empty())
+		{
+			graphicsPipelineCache.SetManifest(&pipelineManifest);
+			computePipelineCache.SetManifest(&pipelineManifest);
+		}
 
 		VkCommandPoolCreateInfo poolCreateInfo = {};
 		poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -170,20 +246,26 @@ namespace Renderer
 
 	bool Core::InitialiseGui()
 	{
+		if (settings.headless) return false; // ImGui needs a window
+
+		// The ImGui backend builds its pipeline against a renderpass, which a dynamic rendering pass isn't compatible with
+		if (device.GetDynamicRendering())
+		{
+			LogWarning("ImGui isn't available with dynamic rendering");
+			return false;
+		}
+
 		ImGui::CreateContext();
 
 		ImGui_ImplGlfw_InitForVulkan(GetSwapchain()->GetWindow(), true);
 
-		VkDescriptorPoolSize pool_sizes[] = {
-			{ VK_DESCRIPTOR_TYPE_SAMPLER, 1000 }, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 }, { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000 }, { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000 }, { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000 }, { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 }, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 }, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 }, { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000 }
-		};
+		// The backend needs a pool of its own, it only ever allocates a combined image sampler per texture it draws (the font atlas)
+		VkDescriptorPoolSize pool_sizes[] = { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16 } };
 
 		VkDescriptorPoolCreateInfo pool_info = {};
 		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-		pool_info.maxSets = 1000;
+		pool_info.maxSets = 16;
 		pool_info.poolSizeCount = std::size(pool_sizes);
 		pool_info.pPoolSizes = pool_sizes;
 
@@ -193,8 +275,8 @@ namespace Renderer
 		info.Device = *GetDevice();
 		info.PhysicalDevice = *GetDevice()->GetPhysicalDevice();
 		info.Instance = *GetDevice()->GetInstance();
-		info.ImageCount = 3;
-		info.MinImageCount = 3;
+		info.ImageCount = GetSwapchain()->GetImageCount();
+		info.MinImageCount = GetSwapchain()->GetImageCount();
 		info.Queue = GetDevice()->queues.graphics;
 		info.QueueFamily = GetDevice()->GetIndices()->graphicsFamily;
 		info.DescriptorPool = imguiPool;
@@ -210,6 +292,8 @@ namespace Renderer
 
 	bool Core::AddGuiPass()
 	{
+		if (imguiPool == nullptr) return false;
+		
 		rendergraph->AddPass("ImGui-Render", QueueType::Graphics)
 			.AddGuiOutput()
 			.SetRecordFunc([](VkCommandBuffer buffer, const FrameInfo& info, GraphContext& context)
@@ -223,28 +307,79 @@ namespace Renderer
 		return true;
 	}
 
+	void Core::RequestDeviceFeatures()
+	{
+		if (settings.extendedDynamicState) device.RequestExtendedDynamicState();
+		if (settings.imagelessFramebuffers) device.RequestImagelessFramebuffer();
+		if (settings.dynamicRendering) device.RequestDynamicRendering();
+		if (settings.bindless) device.RequestDescriptorIndexing();
+		if (settings.pushDescriptors) device.RequestPushDescriptor();
+	}
+
+	uint32_t Core::PrewarmPipelines()
+	{
+		// Without background compilation set up, borrow a compiler for the duration of the load
+		std::unique_ptr<PipelineCompiler> loadingCompiler;
+		if (!pipelineCompiler)
+		{
+			loadingCompiler = std::make_unique<PipelineCompiler>(&pipelineCache, std::max(std::thread::hardware_concurrency(), 1u));
+			graphicsPipelineCache.SetCompiler(loadingCompiler.get());
+		}
+
+		const auto count = pipelineManifest.Prewarm(&graphicsPipelineCache, &computePipelineCache);
+
+		if (loadingCompiler)
+		{
+			// Drains the queue, so everything is compiled once it's gone
+			loadingCompiler.reset();
+			graphicsPipelineCache.SetCompiler(nullptr);
+		}
+
+		LogInfo("Prewarming {} pipelines", count);
+		return count;
+	}
+
 	bool Core::Run()
 	{
+		if (settings.headless) return headlessFrame++ < settings.headlessFrames;
+		
 		if (glfwWindowShouldClose(swapchain.GetWindow())) return false;
 
 		glfwPollEvents();
 
+		if (resizePending)
+		{
+			// Nothing to present to while minimised, sleep until something happens to the window
+			glfwWaitEvents();
+			WindowResize();
+		}
+
 		return true;
 	}
 
 	void Core::WindowResize()
 	{
-		settings.width = 0;
-		settings.height = 0;
-		while (settings.width == 0 || settings.height == 0)
-		{
-			glfwGetFramebufferSize(swapchain.GetWindow(), &settings.width, &settings.height);
-			glfwWaitEvents();
-		}
-		vkDeviceWaitIdle(device);
-		vkQueueWaitIdle(device.queues.graphics);
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(swapchain.GetWindow(), &width, &height);
+
+		resizePending = width == 0 || height == 0;
+		if (resizePending) return;
+
+		settings.width = width;
+		settings.height = height;
 
-		swapchain.BuildSwapchain();
+		// Nothing waits on the GPU here, everything built on the old images is handed to the allocator and
+		// destroyed once the frame slot that last used it comes back around. Pipelines don't depend on the extent
+		const auto oldExtent = swapchain.GetExtent();
+		auto oldViews = std::vector<VkImageView>();
+		for (auto* image : swapchain.GetImages()) oldViews.push_back(image->GetView());
+
+		framebufferCache.Retire(oldViews, { oldExtent }, allocator);
+
+		swapchain.SetSize(width, height);
+		swapchain.BuildSwapchain(settings.vsync, allocator);
+
+		if (oldExtent.width != swapchain.GetExtent().width || oldExtent.height != swapchain.GetExtent().height) rendergraph->Resize();
 	}
 
 	void Core::SetImageLayout(VkCommandBuffer buffer, VkImage image, VkImageLayout oldImageLayout, VkImageLayout newImageLayout, VkImageSubresourceRange subresourceRange, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
@@ -334,42 +469,102 @@ namespace Renderer
 		vkFreeCommandBuffers(device, commandPool, 1, &buffer);
 	}
 
-	void Core::BeginFrame(VkCommandBuffer& buffer, FrameInfo& info)
+	bool Core::BeginFrame(VkCommandBuffer& buffer, FrameInfo& info)
 	{
-		info = swapchain.BeginFrame(buffer);
+		if (swapchain.BeginFrame(buffer, info) == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			WindowResize();
+			return false;
+		}
+
+		// This slot's fence has been waited on, anything freed the last time it was used is safe to destroy
+		allocator->BeginFrame(info.offset);
+		descriptorAllocator.BeginFrame(info.offset);
+		uniformStream.BeginFrame(info.offset);
 
 		descriptorCache.Tick();
+		samplerCache.Tick();
 		graphicsPipelineCache.Tick();
+		computePipelineCache.Tick();
 		renderpassCache.Tick();
 		framebufferCache.Tick();
+		shaderManager->Tick();
+
+		if (settings.statsLogFrames > 0 && info.frameIndex % settings.statsLogFrames == 0) LogStats();
+
+		return true;
+	}
+
+	static void LogCacheStats(const char* name, const CacheStats& stats)
+	{
+		LogInfo("{}: {} entries, {} hits, {} misses, {} evicted", name, stats.size, stats.hits, stats.misses, stats.evictions);
+	}
+
+	void Core::LogStats()
+	{
+		LogCacheStats("Graphics pipelines", graphicsPipelineCache.GetStats());
+		LogCacheStats("Compute pipelines", computePipelineCache.GetStats());
+		LogCacheStats("Renderpasses", renderpassCache.GetStats());
+		LogCacheStats("Framebuffers", framebufferCache.GetStats());
+		LogCacheStats("Descriptor sets", descriptorCache.GetStats());
+		LogCacheStats("Samplers", samplerCache.GetStats());
+
+		// Ticked already, so these are the last frame's
+		const auto& binds = descriptorCache.GetBindStats();
+		LogInfo("Descriptor binds: {} frame, {} pass, {} material, {} draw, {} pushed, {} skipped", binds.binds[0], binds.binds[1], binds.binds[2], binds.binds[3], binds.pushes,
+		        binds.skipped);
 	}
 
 	void Core::EndFrame(FrameInfo info)
 	{
 		const auto result = swapchain.EndFrame(info, device.queues.graphics);
 
+		if (settings.headless) return;
+		
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) WindowResize();
 	}
 
 	Core::~Core()
 	{
-		ImGui_ImplGlfw_Shutdown();
-		ImGui_ImplVulkan_Shutdown();
-		ImGui_ImplVulkan_DestroyFontUploadObjects();
+		if (imguiPool != nullptr)
+		{
+			ImGui_ImplGlfw_Shutdown();
+			ImGui_ImplVulkan_Shutdown();
+			ImGui_ImplVulkan_DestroyFontUploadObjects();
 
-		vkDestroyDescriptorPool(*GetDevice(), imguiPool, nullptr);
-		ImGui::DestroyContext();
+			vkDestroyDescriptorPool(*GetDevice(), imguiPool, nullptr);
+			ImGui::DestroyContext();
+		}
 
 		rendergraph->Clear();
 		rendergraph.reset();
+
+		// Finishes anything still compiling and merges the worker caches before the pipelines go or the cache is saved
+		pipelineCompiler.reset();
+		graphicsPipelineCache.SetCompiler(nullptr);
+
+		uniformStream.Destroy();
+		if (settings.headless) swapchain.DestroyHeadless();
 		delete allocator;
 
 		vkDestroyCommandPool(device, commandPool, nullptr);
 		framebufferCache.ClearCache();
 		graphicsPipelineCache.ClearCache();
+		computePipelineCache.ClearCache();
 		renderpassCache.ClearCache();
 		descriptorCache.ClearCache();
+		samplerCache.ClearCache();
+		descriptorAllocator.Destroy();
+		bindlessHeap.reset();
+
+		pipelineManifest.Save();
+		pipelineCache.Save();
+		pipelineCache.Destroy();
 
 		delete shaderManager;
+
+		// Pipeline layouts hold on to their set layouts
+		pipelineLayoutCache.ClearCache();
+		setLayoutCache.ClearCache();
 	}
 }
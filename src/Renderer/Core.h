@@ -2,16 +2,25 @@
 #include "VulkanObjects/Device.h"
 #include "VulkanObjects/Swapchain.h"
 #include "VulkanObjects/Pipeline.h"
+#include "VulkanObjects/PipelineCache.h"
+#include "VulkanObjects/PipelineCompiler.h"
+#include "VulkanObjects/PipelineManifest.h"
 #include "VulkanObjects/Renderpass.h"
 #include "VulkanObjects/Framebuffer.h"
 
 #include "RenderGraph/RenderGraph.h"
 #include "Resources/ShaderManager.h"
 #include "VulkanObjects/DescriptorSet.h"
+#include "VulkanObjects/DescriptorAllocator.h"
+#include "VulkanObjects/BindlessHeap.h"
+#include "VulkanObjects/UniformStream.h"
+#include "VulkanObjects/SamplerCache.h"
+#include "VulkanObjects/LayoutCache.h"
 
 namespace Renderer
 {
-	enum class RendererBufferSettings { SwapchainSync, SingleBuffered, DoubleBuffered, TripleBuffered };
+	// Frames the CPU can record ahead of the GPU, SwapchainSync uses one per swapchain image
+	enum class RendererBufferSettings { SwapchainSync, SingleBuffered, DoubleBuffered, TripleBuffered, QuadrupleBuffered };
 
 	struct Settings
 	{
@@ -22,6 +31,51 @@ namespace Renderer
 		bool vsync = false;
 		bool validationLayers = false;
 		std::vector<std::string> enabledExtensions;
+
+		// Where compiled pipelines are kept between runs, empty to keep them in memory only
+		std::string pipelineCachePath = "pipeline.cache";
+
+		// Threads compiling graphics pipelines in the background, draws using one that isn't ready yet are skipped
+		// or fall back to GraphicsPipelineCache::SetDefaultPipeline. 0 compiles on the recording thread
+		uint32_t pipelineCompileThreads = 0;
+
+		// Every pipeline requested is recorded here, PrewarmPipelines creates them all on the next run. Empty to not record
+		std::string pipelineManifestPath = "pipeline.manifest";
+
+		// Uses VK_EXT_extended_dynamic_state when available, so pipelines differing only in depth state, cull mode
+		// or topology within a class are shared
+		bool extendedDynamicState = false;
+
+		// One framebuffer per attachment configuration rather than per set of views, where supported
+		bool imagelessFramebuffers = true;
+
+		// Passes begin with VK_KHR_dynamic_rendering where supported, skipping renderpass and framebuffer objects entirely.
+		// Graphics pipelines are then keyed by GraphContext's attachment formats rather than a renderpass
+		bool dynamicRendering = false;
+
+		// A global descriptor heap through descriptor indexing where supported, see BindlessHeap. Programs then declare
+		// their own descriptors in set 1
+		bool bindless = false;
+
+		// VK_KHR_push_descriptor where supported, programs can then declare a set after their own whose bindings are
+		// pushed while recording, see ShaderProgram
+		bool pushDescriptors = true;
+
+		// Bytes of dynamic uniform data each frame can stream through DescriptorSetCache::SetResource
+		uint32_t uniformStreamSize = 4 * 1024 * 1024;
+
+		// Framebuffers, graphics pipelines, material instance descriptor sets and unreferenced samplers not looked up for this
+		// many frames are destroyed, 0 keeps them. Descriptor sets written by hand are kept, see DescriptorSetBundle::IsPinned
+		uint32_t cacheMaxAge = 0;
+		// Entries each of those caches holds before the least recently used go, 0 for no limit
+		size_t cacheBudget = 0;
+
+		// Cache hit rates and descriptor binds by frequency are logged every this many frames, 0 to not log
+		uint32_t statsLogFrames = 600;
+
+		// No window, surface or swapchain, the backbuffer is an offscreen image ring and Run stops after headlessFrames
+		bool headless = false;
+		uint32_t headlessFrames = 1;
 	};
 
 	class Core
@@ -35,21 +89,40 @@ namespace Renderer
 		bool AddGuiPass();
 		bool Run();
 
+		// Creates every pipeline in the manifest in parallel, meant for loading screens. Waits for them unless
+		// pipelineCompileThreads is set, in which case they carry on compiling in the background
+		uint32_t PrewarmPipelines();
+
 		~Core();
 	private:
 
 		Settings settings;
-		VkDescriptorPool imguiPool;
+		VkDescriptorPool imguiPool = nullptr;
+		uint32_t headlessFrame = 0;
+
+		// Set while the window is minimised, the swapchain is rebuilt once it has a size again
+		bool resizePending = false;
 
 		Device device;
 		Swapchain swapchain; // VkSwapchainKHR
 		Memory::Allocator* allocator;
 
+		PipelineCache pipelineCache;
+		std::unique_ptr<PipelineCompiler> pipelineCompiler;
+		PipelineManifest pipelineManifest;
+
 		// caches
 		RenderpassCache renderpassCache;
 		GraphicsPipelineCache graphicsPipelineCache;
+		ComputePipelineCache computePipelineCache;
 		FramebufferCache framebufferCache;
 		DescriptorSetCache descriptorCache;
+		SamplerCache samplerCache;
+		DescriptorSetLayoutCache setLayoutCache;
+		PipelineLayoutCache pipelineLayoutCache;
+		DescriptorAllocator descriptorAllocator;
+		UniformStream uniformStream;
+		std::unique_ptr<BindlessHeap> bindlessHeap;
 		ShaderManager* shaderManager;
 
 		VkCommandPool commandPool;
@@ -61,6 +134,9 @@ namespace Renderer
 		void initialiseDescriptorPool(GraphicsPipelineKey key);
 		void initialiseDescriptorSets(GraphicsPipelineKey key);
 		void WindowResize();
+		// Optional device features from settings, between picking the physical device and building the logical one
+		void RequestDeviceFeatures();
+		void LogStats();
 
 	public:
 
@@ -73,8 +149,16 @@ namespace Renderer
 
 		RenderpassCache* GetRenderpassCache() { return &renderpassCache; }
 		GraphicsPipelineCache* GetGraphicsPipelineCache() { return &graphicsPipelineCache; }
+		ComputePipelineCache* GetComputePipelineCache() { return &computePipelineCache; }
+		PipelineCache* GetPipelineCache() { return &pipelineCache; }
+		PipelineManifest* GetPipelineManifest() { return &pipelineManifest; }
 		FramebufferCache* GetFramebufferCache() { return &framebufferCache; }
 		DescriptorSetCache* GetDescriptorSetCache() { return &descriptorCache; }
+		SamplerCache* GetSamplerCache() { return &samplerCache; }
+		PipelineLayoutCache* GetPipelineLayoutCache() { return &pipelineLayoutCache; }
+		DescriptorAllocator* GetDescriptorAllocator() { return &descriptorAllocator; }
+		// nullptr unless Settings::bindless was set and the device supports it
+		BindlessHeap* GetBindlessHeap() { return bindlessHeap.get(); }
 
 		ShaderManager* GetShaderManager() { return shaderManager; }
 		Settings* GetSettings() { return &settings; }
@@ -85,11 +169,9 @@ namespace Renderer
 		VkCommandBuffer GetCommandBuffer(VkCommandBufferLevel level, bool begin);
 		void FlushCommandBuffer(VkCommandBuffer buffer);
 
-		void BeginFrame(VkCommandBuffer& buffer, FrameInfo& info);
+		// False if the swapchain was out of date, nothing should be recorded or submitted this frame
+		bool BeginFrame(VkCommandBuffer& buffer, FrameInfo& info);
 		void EndFrame(FrameInfo info);
 
-	private:
-		uint32_t maxFramesInFlight;
-		int bufferCopies = 2;
 	};
 }
@@ -156,11 +156,14 @@ namespace Renderer::Memory
 		});
 	}
 
-	void Allocator::BeginFrame() { }
+	void Allocator::Defer(std::function<void(VkDevice)> cleanup)
+	{
+		cleanups[currentFrameOffset].emplace_back(std::move(cleanup));
+	}
 
-	void Allocator::EndFrame()
+	void Allocator::BeginFrame(uint32_t frameOffset)
 	{
-		currentFrameOffset = (currentFrameOffset + 1) % framesInFlight;
+		currentFrameOffset = frameOffset;
 		for (const auto& cleanup : cleanups[currentFrameOffset]) { cleanup(*device); }
 		cleanups[currentFrameOffset].clear();
 	}
@@ -45,8 +45,11 @@ namespace Renderer::Memory
 		void DeallocateBuffer(Buffer* buffer);
 		void DeallocateImage(Image* image);
 
-		void BeginFrame();
-		void EndFrame();
+		// Runs cleanup once the frame currently being recorded is no longer in flight
+		void Defer(std::function<void(VkDevice)> cleanup);
+
+		// Runs the cleanups deferred the last time this frame slot was used, call once its fence is signalled
+		void BeginFrame(uint32_t frameOffset);
 
 		void DebugView();
 
@@ -13,7 +13,7 @@ namespace Renderer::Memory
 
 		VkExtent3D extent;
 		VkFormat format;
-		VkImageUsageFlags usage;
+		VkImageUsageFlags usage = 0;
 		VkImageSubresourceRange range;
 
 		std::function<void(Image*)> cleanup;
@@ -26,8 +26,8 @@ namespace Renderer::Memory
 		Image(VkImage image, VkImageView view, Allocation alloc, VkImageSubresourceRange range, VkExtent3D extent, VkFormat format, VkImageUsageFlags usage, const std::function<void(Image*)>& cleanup) : MemoryResource(alloc, image),
 			view(view), extent(extent), format(format), usage(usage), range(range), cleanup(cleanup) { }
 
-		Image(VkImage image, VkImageView view, VkImageSubresourceRange range, VkExtent3D extent, VkFormat format) : MemoryResource(Allocation{nullptr, VkDeviceSize(-1), VkDeviceSize(0), false}, image),
-			view(view), extent(extent), format(format), range(range) { }
+		Image(VkImage image, VkImageView view, VkImageSubresourceRange range, VkExtent3D extent, VkFormat format, VkImageUsageFlags usage) : MemoryResource(Allocation{nullptr, VkDeviceSize(-1), VkDeviceSize(0), false}, image),
+			view(view), extent(extent), format(format), usage(usage), range(range) { }
 
 		~Image() { if(cleanup != nullptr) cleanup(this); }
 
@@ -35,6 +35,7 @@ namespace Renderer::Memory
 		VkExtent2D GetExtent() const { return { extent.width, extent.height }; }
 		VkExtent3D GetExtent3D() const { return extent; }
 		VkFormat& GetFormat() { return format; }
+		VkImageUsageFlags GetUsage() const { return usage; }
 		VkImageSubresourceRange& GetSubresourceRange() { return range; }
 	};
 }
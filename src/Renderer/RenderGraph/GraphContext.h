@@ -5,5 +5,9 @@ namespace Renderer
 	{
 		VkRenderPass renderPass;
 		VkExtent2D extent;
+
+		// With dynamic rendering there's no renderpass, pipelines are made against the attachment formats instead
+		const VkFormat* colourFormats = nullptr;
+		uint32_t colourCount = 0;
 	};
 }
\ No newline at end of file
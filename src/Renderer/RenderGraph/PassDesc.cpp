@@ -90,6 +90,7 @@ namespace Renderer
 		auto& res = graph->GetImage(name);
 
 		feedbackResources.emplace_back(res);
+		feedbackResources.back().ReadBy(usage); // Only recorded on our copy, reading our own output isn't a dependency
 		
 		return *this;
 	}
@@ -113,6 +114,13 @@ namespace Renderer
 		return *this;
 	}
 
+	PassDesc& PassDesc::SetEnableFunc(std::function<bool()> func)
+	{
+		this->enabled = std::move(func);
+
+		return *this;
+	}
+
 
 
 }
@@ -28,6 +28,7 @@ namespace Renderer
 		std::vector<Resource> feedbackResources;
 
 		std::function<void(VkCommandBuffer, const FrameInfo&, GraphContext& context)> execute;
+		std::function<bool()> enabled;
 
 	private:
 		bool WritesTo(const std::string& name);
@@ -57,6 +58,11 @@ namespace Renderer
 
 		// Set the record function for the pass
 		PassDesc& SetRecordFunc(std::function<void(VkCommandBuffer, const FrameInfo&, GraphContext& context)> func);
+
+		// Evaluated every frame in Execute, when false the pass (and anything only fed by it) is skipped without rebuilding the graph
+		PassDesc& SetEnableFunc(std::function<bool()> func);
+
+		bool IsConditional() const { return static_cast<bool>(enabled); }
 	};
 
 }
@@ -1,14 +1,64 @@
 #include "RenderGraph.h"
+#include "GraphContext.h"
 #include "../Core.h"
+#include "../Memory/Allocator.h"
+#include "../Memory/Buffer.h"
+#include "../Memory/Image.h"
 #include <unordered_set>
 
 namespace Renderer
 {
 
+	static constexpr VkAccessFlags writeAccess = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	// Layout every colour attachment is left in by the Renderpass, or transitioned to beforehand with dynamic rendering
+	static constexpr VkImageLayout attachmentLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	static bool IsAttachmentWrite(const Usage& usage) { return usage.flags & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; }
+
+	static VkImageUsageFlags InferImageUsage(const ImageResource& resource)
+	{
+		VkImageUsageFlags usage = 0;
+
+		for (auto& write : resource.writes)
+		{
+			if (IsAttachmentWrite(write)) usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			else if (write.flags & VK_PIPELINE_STAGE_TRANSFER_BIT) usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			else usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		}
+
+		for (auto& read : resource.reads)
+		{
+			if (read.flags & VK_PIPELINE_STAGE_TRANSFER_BIT) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			else usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+
+		return usage;
+	}
+
+	// Schedules expect every image to start the frame in its resting layout
+	static void AddRestingTransitions(std::vector<VkImageMemoryBarrier>& transitions, const ImageResource& resource)
+	{
+		for ( auto* frameImage : resource.images )
+		{
+			VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = resource.info.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = frameImage->GetResourceHandle();
+			barrier.subresourceRange = frameImage->GetSubresourceRange();
+
+			transitions.push_back(barrier);
+		}
+	}
+
 	RenderGraph::RenderGraph(Core* core)
-		: framesInFlight(core->GetSwapchain()->GetFramesInFlight()), device(*core->GetDevice())
+		: core(core), framesInFlight(core->GetSwapchain()->GetFramesInFlight()), device(*core->GetDevice()),
+		  resolutionScaler(core->GetDevice(), core->GetSwapchain()->GetFramesInFlight())
 	{
-		backBuffer.images = core->GetSwapchain()->GetImages();
+		dynamicRendering = core->GetDevice()->GetDynamicRendering();
 
 		// Initialise our 3 queues
 		
@@ -96,11 +146,47 @@ namespace Renderer
 		return static_cast<BufferResource&>(*resources.back());
 	}
 	
+	PassDesc& RenderGraph::AddUpscalePass(const std::string& source)
+	{
+		auto* image = &GetImage(source);
+		
+		return AddPass("Upscale " + source, QueueType::Graphics)
+			.AddReadImage(source, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+			.AddWrittenImage(backBuffer.name, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, {})
+			.SetRecordFunc([this, image](VkCommandBuffer buffer, const FrameInfo& frameInfo, GraphContext& context)
+			{
+				auto* src = GetFrameImage(image, frameInfo);
+				auto* dst = GetFrameImage(&backBuffer, frameInfo);
+
+				const auto srcExtent = src->GetExtent();
+				const auto dstExtent = dst->GetExtent();
+
+				VkImageBlit blit = {};
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.srcOffsets[1] = { static_cast<int32_t>(srcExtent.width), static_cast<int32_t>(srcExtent.height), 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.dstOffsets[1] = { static_cast<int32_t>(dstExtent.width), static_cast<int32_t>(dstExtent.height), 1 };
+
+				vkCmdBlitImage(buffer, src->GetResourceHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst->GetResourceHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1, &blit, VK_FILTER_LINEAR);
+			});
+	}
+	
+	Resource* RenderGraph::FindResource(const std::string& name)
+	{
+		if(name == backBuffer.name) return &backBuffer;
+
+		auto val = nameToResource.find(name);
+
+		return val != nameToResource.end() ? resources[val->second].get() : nullptr;
+	}
+	
 	void RenderGraph::Build()
 	{
 		CreateGraph();
 		ValidateGraph();
 		CreateResources();
+		CreateSchedules();
 	}
 
 	void RenderGraph::Clear()
@@ -111,6 +197,11 @@ namespace Renderer
 		nameToPass.clear();
 		nameToResource.clear();
 
+		schedules.clear();
+		conditionalPasses.clear();
+		commandBuffers.clear();
+		pendingTransitions.clear();
+
 		vkDestroyCommandPool(device, queues.graphics.commandPool, nullptr);
 		vkDestroyCommandPool(device, queues.transfer.commandPool, nullptr);
 		vkDestroyCommandPool(device, queues.compute.commandPool, nullptr);
@@ -118,7 +209,76 @@ namespace Renderer
 	
 	void RenderGraph::Execute()
 	{
-	
+		const auto& schedule = GetSchedule(GetEnableMask());
+
+		auto* framebufferCache = core->GetFramebufferCache();
+		auto buffer = commandBuffers[core->GetSwapchain()->GetIndex()];
+
+		FrameInfo frameInfo;
+		if (!core->BeginFrame(buffer, frameInfo)) return; // Swapchain was out of date, it's been rebuilt for the next frame
+
+		VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(buffer, &beginInfo);
+
+		// Stays bound for every pass, pipelines from bindless programs all agree on set 0
+		if (auto* heap = core->GetBindlessHeap()) heap->Bind(buffer);
+
+		resolutionScaler.BeginFrame(buffer, frameInfo.offset);
+		if (resolutionScaler.GetLevel() != resolutionLevel) UpdateResolution();
+
+		if (!pendingTransitions.empty())
+		{
+			vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+				static_cast<uint32_t>(pendingTransitions.size()), pendingTransitions.data());
+			pendingTransitions.clear();
+		}
+
+		for (auto& scheduled : schedule.passes)
+		{
+			RecordBarriers(buffer, scheduled.barriers, frameInfo);
+
+			GraphContext context = { nullptr, core->GetSwapchain()->GetExtent() };
+
+			const bool rendering = !scheduled.attachments.empty();
+			if (rendering)
+			{
+				attachmentImages.clear();
+				for (auto* attachment : scheduled.attachments) attachmentImages.push_back(GetFrameImage(attachment, frameInfo));
+
+				context.extent = attachmentImages.front()->GetExtent();
+
+				if (dynamicRendering)
+				{
+					context.colourFormats = scheduled.colourFormats.data();
+					context.colourCount = static_cast<uint32_t>(scheduled.colourFormats.size());
+
+					BeginRendering(buffer, scheduled, context.extent);
+				}
+				else
+				{
+					context.renderPass = scheduled.renderpass->GetHandle();
+
+					framebufferCache->BeginPass(buffer, attachmentImages, scheduled.renderpass, context.extent);
+				}
+			}
+
+			if (scheduled.pass->execute) scheduled.pass->execute(buffer, frameInfo, context);
+
+			if (rendering)
+			{
+				if (dynamicRendering) dynamicRendering->endRendering(buffer);
+				else framebufferCache->EndPass(buffer);
+			}
+		}
+
+		RecordBarriers(buffer, schedule.finalBarriers, frameInfo);
+
+		resolutionScaler.EndFrame(buffer, frameInfo.offset);
+
+		vkEndCommandBuffer(buffer);
+
+		core->EndFrame(frameInfo);
 	}
 	
 	void RenderGraph::CreateGraph()
@@ -216,6 +376,9 @@ namespace Renderer
 		}
 
 		renderPasses = std::move(copyPasses);
+
+		// Indices have moved, names need to point at the sorted order
+		for(uint32_t i = 0; i < renderPasses.size(); i++) nameToPass[renderPasses[i]->name] = i;
 	}
 
 	bool RenderGraph::ValidateGraph()
@@ -240,7 +403,433 @@ namespace Renderer
 	
 	void RenderGraph::CreateResources()
 	{
+		auto* swapchain = core->GetSwapchain();
+		auto* allocator = core->GetAllocator();
+
+		auto transitions = std::vector<VkImageMemoryBarrier>();
+		resolutionLevel = resolutionScaler.GetLevel();
+
+		for ( auto& resource : resources )
+		{
+			if (auto* image = dynamic_cast<ImageResource*>(resource.get()))
+			{
+				if (!image->images.empty()) continue;
+				
+				auto& info = image->info;
+				if (info.sizeType == static_cast<ImageSize>(0)) info.sizeType = ImageSize::Swapchain;
+				if (info.format == VK_FORMAT_UNDEFINED) info.format = swapchain->GetFormat();
+				if (info.layout == VK_IMAGE_LAYOUT_UNDEFINED) info.layout = VK_IMAGE_LAYOUT_GENERAL; // Resting layout between frames
+				info.usage |= InferImageUsage(*image);
+
+				if (image->IsDynamic()) image->UseLevel(resolutionLevel, allocator, swapchain->GetExtent(), framesInFlight);
+				else image->Build(allocator, swapchain->GetExtent(), framesInFlight);
+
+				AddRestingTransitions(transitions, *image);
+			}
+			else if (auto* buffer = dynamic_cast<BufferResource*>(resource.get()))
+			{
+				if (buffer->buffers.empty()) buffer->Build(allocator, swapchain->GetExtent(), framesInFlight);
+			}
+		}
+
+		if (!transitions.empty())
+		{
+			auto* buffer = core->GetCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(transitions.size()), transitions.data());
+			core->FlushCommandBuffer(buffer);
+		}
+
+		if (commandBuffers.empty())
+		{
+			commandBuffers.resize(framesInFlight);
+
+			VkCommandBufferAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			allocInfo.commandPool = queues.graphics.commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = framesInFlight;
+
+			const auto success = vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data());
+			Assert(success == VK_SUCCESS, "Failed to allocate graph command buffers");
+		}
+	}
+
+	void RenderGraph::UpdateResolution()
+	{
+		auto* swapchain = core->GetSwapchain();
+		auto* allocator = core->GetAllocator();
+
+		resolutionLevel = resolutionScaler.GetLevel();
+		
+		for ( auto& resource : resources )
+		{
+			auto* image = dynamic_cast<ImageResource*>(resource.get());
+			if (!image || !image->IsDynamic()) continue;
+
+			// Levels we've already visited are still in their resting layout, in-flight frames keep using the old level's images
+			if (image->UseLevel(resolutionLevel, allocator, swapchain->GetExtent(), framesInFlight)) AddRestingTransitions(pendingTransitions, *image);
+		}
+	}
+
+	void RenderGraph::Resize()
+	{
+		auto* swapchain = core->GetSwapchain();
+		auto* allocator = core->GetAllocator();
+
+		auto retiredViews = std::vector<VkImageView>();
+		auto retiredExtents = std::vector<VkExtent2D>();
+		
+		for ( auto& resource : resources )
+		{
+			auto* image = dynamic_cast<ImageResource*>(resource.get());
+			if (!image || image->images.empty() || image->info.sizeType == ImageSize::Fixed) continue;
+
+			// Dynamic images drop every level, the other levels get rebuilt at the new size when they're next used
+			image->Release(retiredViews, retiredExtents);
+
+			if (image->IsDynamic()) image->UseLevel(resolutionLevel, allocator, swapchain->GetExtent(), framesInFlight);
+			else image->Build(allocator, swapchain->GetExtent(), framesInFlight);
+
+			AddRestingTransitions(pendingTransitions, *image);
+		}
+
+		// Schedules only hold resources, not images, so they stay valid
+		core->GetFramebufferCache()->Retire(retiredViews, retiredExtents, allocator);
+	}
+
+	void RenderGraph::CreateSchedules()
+	{
+		schedules.clear();
+		conditionalPasses.clear();
+
+		for (uint32_t i = 0; i < renderPasses.size(); i++)
+		{
+			if (renderPasses[i]->IsConditional()) conditionalPasses.push_back(i);
+		}
+
+		Assert(conditionalPasses.size() <= maxConditionalPasses, "Too many conditional passes to compile every schedule upfront, see RenderGraph::maxConditionalPasses");
+
+		// Compile every combination upfront so toggling a pass never costs anything at Execute
+		const uint32_t combinations = 1u << conditionalPasses.size();
+		schedules.reserve(combinations);
+		for (uint32_t mask = 0; mask < combinations; mask++) schedules.emplace(mask, CompileSchedule(mask));
+	}
+
+	uint32_t RenderGraph::GetEnableMask() const
+	{
+		uint32_t mask = 0;
+
+		for (uint32_t i = 0; i < conditionalPasses.size(); i++)
+		{
+			if (renderPasses[conditionalPasses[i]]->enabled()) mask |= 1u << i;
+		}
+
+		return mask;
+	}
+
+	const Schedule& RenderGraph::GetSchedule(uint32_t enableMask)
+	{
+		// Every mask was compiled by CreateSchedules
+		auto val = schedules.find(enableMask);
+		Assert(val != schedules.end(), "Enable mask has no schedule, was the graph rebuilt?");
+
+		return val->second;
+	}
+
+	Schedule RenderGraph::CompileSchedule(uint32_t enableMask)
+	{
+		// Indexed by passId
+		auto enabled = std::vector<bool>(renderPasses.size(), true);
+		for (uint32_t i = 0; i < conditionalPasses.size(); i++) enabled[renderPasses[conditionalPasses[i]]->passId] = enableMask & (1u << i);
+
+		struct State
+		{
+			VkPipelineStageFlags stage = 0;
+			VkAccessFlags access = 0;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		};
+		
+		auto states = std::unordered_map<Resource*, State>();
+		
+		// The acquire semaphore is waited on at colour output, so the first use of the backbuffer has to come after it
+		states[&backBuffer] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+
+		auto getState = [&](Resource* resource) -> State&
+		{
+			auto [iter, inserted] = states.try_emplace(resource);
+			if (inserted)
+			{
+				if (auto* image = dynamic_cast<ImageResource*>(resource)) iter->second.layout = image->info.layout;
+			}
+			return iter->second;
+		};
+
+		// Transition a resource into a new use, layout of VK_IMAGE_LAYOUT_UNDEFINED keeps whatever layout it's in
+		auto use = [&](std::vector<Barrier>& barriers, Resource* resource, VkPipelineStageFlags stage, VkAccessFlags access, VkImageLayout layout)
+		{
+			auto& state = getState(resource);
+			auto* image = dynamic_cast<ImageResource*>(resource);
+
+			const bool layoutChange = image && layout != VK_IMAGE_LAYOUT_UNDEFINED && layout != state.layout;
+			const bool hazard = (state.access & writeAccess) || ((access & writeAccess) && state.stage != 0);
+
+			if (!layoutChange && !hazard)
+			{
+				// Read after read, just widen the last use
+				state.stage |= stage;
+				state.access |= access;
+				return;
+			}
+
+			Barrier barrier = {};
+			barrier.image = image;
+			barrier.buffer = image ? nullptr : static_cast<BufferResource*>(resource);
+			barrier.srcStage = state.stage ? state.stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			barrier.dstStage = stage;
+			barrier.srcAccess = state.access & writeAccess;
+			barrier.dstAccess = access;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = layoutChange ? layout : state.layout;
+
+			barriers.push_back(barrier);
+
+			state = { stage, access, barrier.newLayout };
+		};
+
+		struct PassAccess
+		{
+			Resource* resource;
+			VkPipelineStageFlags stage;
+			VkAccessFlags access;
+			VkImageLayout layout;
+			bool attachment;
+		};
+
+		auto schedule = Schedule();
+		auto accesses = std::vector<PassAccess>();
+		auto swapchainFormat = core->GetSwapchain()->GetFormat();
+		
+		for (auto& pass : renderPasses)
+		{
+			if (!enabled[pass->passId]) continue;
+
+			// Anything fed only by disabled passes gets skipped along with them
+			for (auto& read : pass->readResources)
+			{
+				auto* resource = FindResource(read.name);
+				if (resource == &backBuffer || resource->writes.empty()) continue;
+
+				bool written = false;
+				for (auto& write : resource->writes) written |= write.passId != pass->passId && enabled[write.passId];
+				
+				if (!written)
+				{
+					enabled[pass->passId] = false;
+					break;
+				}
+			}
+			
+			if (!enabled[pass->passId]) continue;
+
+			accesses.clear();
+			auto addAccess = [&](Resource* resource, const Usage& usage, bool attachment)
+			{
+				for (auto& access : accesses)
+				{
+					if (access.resource != resource) continue;
+
+					access.stage |= usage.flags;
+					access.access |= usage.access;
+					access.attachment |= attachment;
+					if (usage.layout != VK_IMAGE_LAYOUT_UNDEFINED) access.layout = usage.layout;
+					return;
+				}
+
+				accesses.push_back({ resource, usage.flags, usage.access, usage.layout, attachment });
+			};
+
+			// Our copies hold every usage up to when they were added, so the last one is always this pass
+			for (auto& read : pass->readResources)
+			{
+				auto* resource = FindResource(read.name);
+				addAccess(resource, read.reads.back(), resource == &backBuffer);
+			}
+			for (auto& write : pass->writtenResources) addAccess(FindResource(write.name), write.writes.back(), IsAttachmentWrite(write.writes.back()));
+			for (auto& feedback : pass->feedbackResources) addAccess(FindResource(feedback.name), feedback.reads.back(), false);
+
+			ScheduledPass scheduled = {};
+			scheduled.pass = pass.get();
+
+			auto colourAttachments = std::vector<AttachmentDesc>();
+
+			for (auto& access : accesses)
+			{
+				if (!access.attachment)
+				{
+					// Only the backbuffer can still be undefined here, give shader access something usable
+					auto layout = access.layout;
+					if (layout == VK_IMAGE_LAYOUT_UNDEFINED && (access.access & VK_ACCESS_TRANSFER_WRITE_BIT)) layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					if (layout == VK_IMAGE_LAYOUT_UNDEFINED && getState(access.resource).layout == VK_IMAGE_LAYOUT_UNDEFINED) layout = VK_IMAGE_LAYOUT_GENERAL;
+					
+					use(scheduled.barriers, access.resource, access.stage, access.access, layout);
+					continue;
+				}
+
+				auto* image = static_cast<ImageResource*>(access.resource);
+
+				// Load what's already there if something earlier wrote to it this frame
+				auto& state = getState(image);
+				const bool load = image == &backBuffer ? state.layout != VK_IMAGE_LAYOUT_UNDEFINED : false;
+				
+				const auto barrierCount = scheduled.barriers.size();
+				use(scheduled.barriers, image, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0),
+					load || dynamicRendering ? attachmentLayout : VK_IMAGE_LAYOUT_UNDEFINED);
+
+				// Nothing does the transition for us with dynamic rendering, but contents about to be cleared can still be discarded
+				if (dynamicRendering && !load && scheduled.barriers.size() > barrierCount) scheduled.barriers.back().oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+				// The renderpass takes care of the transition, and leaves it in its final layout
+				getState(image).layout = attachmentLayout;
+
+				colourAttachments.push_back({ image == &backBuffer ? swapchainFormat : image->info.format, load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR });
+				scheduled.attachments.push_back(image);
+				scheduled.colourFormats.push_back(colourAttachments.back().format);
+				scheduled.loadOps.push_back(colourAttachments.back().loadOp);
+			}
+
+			if (!scheduled.attachments.empty() && !dynamicRendering)
+			{
+				scheduled.renderpass = core->GetRenderpassCache()->Get(RenderpassKey(std::move(colourAttachments), {}));
+			}
+
+			schedule.passes.push_back(std::move(scheduled));
+		}
+
+		if (getState(&backBuffer).layout == VK_IMAGE_LAYOUT_UNDEFINED) LogWarning("No enabled pass writes to the backbuffer");
+
+		for (auto& [resource, state] : states)
+		{
+			auto* image = dynamic_cast<ImageResource*>(resource);
+			if (!image) continue;
+			
+			const auto restingLayout = image == &backBuffer ? core->GetSwapchain()->GetPresentLayout() : image->info.layout;
+			if (state.layout == restingLayout) continue;
+
+			Barrier barrier = {};
+			barrier.image = image;
+			barrier.srcStage = state.stage;
+			barrier.dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			barrier.srcAccess = state.access & writeAccess;
+			barrier.dstAccess = 0;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = restingLayout;
+
+			schedule.finalBarriers.push_back(barrier);
+		}
+
+		return schedule;
+	}
+
+	Memory::Image* RenderGraph::GetFrameImage(ImageResource* resource, const FrameInfo& frameInfo)
+	{
+		if (resource == &backBuffer) return core->GetSwapchain()->GetImages()[frameInfo.imageIndex];
+
+		return resource->images[frameInfo.offset];
+	}
+
+	void RenderGraph::BeginRendering(VkCommandBuffer buffer, const ScheduledPass& scheduled, VkExtent2D extent)
+	{
+		renderingAttachments.clear();
+		for (uint32_t i = 0; i < attachmentImages.size(); i++)
+		{
+			VkRenderingAttachmentInfoKHR attachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+			attachment.imageView = attachmentImages[i]->GetView();
+			attachment.imageLayout = attachmentLayout;
+			attachment.loadOp = scheduled.loadOps[i];
+			attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachment.clearValue = { { 0.2f, 0.2f, 0.2f, 1.0f } };
+
+			renderingAttachments.push_back(attachment);
+		}
+
+		VkRenderingInfoKHR renderingInfo = { VK_STRUCTURE_TYPE_RENDERING_INFO_KHR };
+		renderingInfo.renderArea.extent = extent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = static_cast<uint32_t>(renderingAttachments.size());
+		renderingInfo.pColorAttachments = renderingAttachments.data();
+
+		VkViewport viewport = {};
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0;
+		viewport.maxDepth = 1;
+
+		VkRect2D rect = {};
+		rect.extent = extent;
+
+		dynamicRendering->beginRendering(buffer, &renderingInfo);
+
+		vkCmdSetViewport(buffer, 0, 1, &viewport);
+		vkCmdSetScissor(buffer, 0, 1, &rect);
+	}
+
+	void RenderGraph::RecordBarriers(VkCommandBuffer buffer, const std::vector<Barrier>& barriers, const FrameInfo& frameInfo)
+	{
+		if (barriers.empty()) return;
+
+		imageBarriers.clear();
+		bufferBarriers.clear();
+
+		VkPipelineStageFlags srcStage = 0;
+		VkPipelineStageFlags dstStage = 0;
+		
+		// Barriers with no layout change only need to make memory available
+		VkMemoryBarrier memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+
+		for (auto& barrier : barriers)
+		{
+			srcStage |= barrier.srcStage;
+			dstStage |= barrier.dstStage;
+
+			if (barrier.buffer)
+			{
+				VkBufferMemoryBarrier bufferBarrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+				bufferBarrier.srcAccessMask = barrier.srcAccess;
+				bufferBarrier.dstAccessMask = barrier.dstAccess;
+				bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.buffer = *barrier.buffer->buffers[frameInfo.offset];
+				bufferBarrier.offset = 0;
+				bufferBarrier.size = VK_WHOLE_SIZE;
+
+				bufferBarriers.push_back(bufferBarrier);
+			}
+			else if (barrier.oldLayout == barrier.newLayout)
+			{
+				memoryBarrier.srcAccessMask |= barrier.srcAccess;
+				memoryBarrier.dstAccessMask |= barrier.dstAccess;
+			}
+			else
+			{
+				auto* image = GetFrameImage(barrier.image, frameInfo);
+				
+				VkImageMemoryBarrier imageBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+				imageBarrier.srcAccessMask = barrier.srcAccess;
+				imageBarrier.dstAccessMask = barrier.dstAccess;
+				imageBarrier.oldLayout = barrier.oldLayout;
+				imageBarrier.newLayout = barrier.newLayout;
+				imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.image = image->GetResourceHandle();
+				imageBarrier.subresourceRange = image->GetSubresourceRange();
+
+				imageBarriers.push_back(imageBarrier);
+			}
+		}
+
+		const uint32_t memoryBarrierCount = memoryBarrier.srcAccessMask || memoryBarrier.dstAccessMask ? 1 : 0;
 		
+		vkCmdPipelineBarrier(buffer, srcStage, dstStage, 0, memoryBarrierCount, &memoryBarrier, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
 	}
 
 }
\ No newline at end of file
@@ -7,13 +7,20 @@
 #include <vulkan.h>
 
 #include "Resource.h"
+#include "ResolutionScaler.h"
 
 
 namespace Renderer
 {
 	class Core;
+	struct Renderpass;
+	struct FrameInfo;
+	struct DynamicRendering;
+	namespace Memory { class Image; }
+	
 	enum class QueueType : char { CPU = 1 << 0, Graphics = 1 << 1, Compute = 1 << 2, Transfer = 1 << 3, AsyncCompute = 1 << 4 };
-	enum class ImageSize : char { Swapchain = 1 << 0, Fixed = 1 << 1 };
+	// SwapchainRelative is scaled by ImageInfo::scale, Dynamic is additionally scaled by the ResolutionScaler
+	enum class ImageSize : char { Swapchain = 1 << 0, Fixed = 1 << 1, SwapchainRelative = 1 << 2, Dynamic = 1 << 3 };
 
 	struct Queue
 	{
@@ -22,10 +29,52 @@ namespace Renderer
 		VkCommandPool commandPool;
 	};
 	
+	struct Barrier
+	{
+		// One of these is set
+		ImageResource* image = nullptr;
+		BufferResource* buffer = nullptr;
+		
+		VkPipelineStageFlags srcStage, dstStage;
+		VkAccessFlags srcAccess, dstAccess;
+		
+		// Only used by image resources
+		VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	struct ScheduledPass
+	{
+		PassDesc* pass;
+
+		// Barriers recorded before the pass executes
+		std::vector<Barrier> barriers;
+
+		// Only set for passes which render to colour attachments, renderpass stays null with dynamic rendering
+		Renderpass* renderpass = nullptr;
+		std::vector<ImageResource*> attachments;
+		std::vector<VkFormat> colourFormats;
+		std::vector<VkAttachmentLoadOp> loadOps;
+	};
+
+	// The pass order and every barrier for one combination of enabled passes, compiled once and replayed each frame
+	struct Schedule
+	{
+		std::vector<ScheduledPass> passes;
+
+		// Return everything to its resting layout, so any schedule can follow any other
+		std::vector<Barrier> finalBarriers;
+	};
+	
 	class RenderGraph
 	{
 	friend class PassDesc;
+		// Every combination of conditional passes is compiled at Build, renderpasses included, so Execute never does.
+		// That's 2^n schedules, more conditional passes than this is refused rather than hitching or taking forever to build
+		static constexpr uint32_t maxConditionalPasses = 8;
+		
 		ImageResource backBuffer{ "_backBuffer" };
+		Core* core;
 		VkDevice device;
 		uint32_t framesInFlight;
 
@@ -40,8 +89,32 @@ namespace Renderer
 			Queue graphics, compute, transfer;
 		} queues;
 
+		std::vector<VkCommandBuffer> commandBuffers;
+
+		// Indices into renderPasses, bit i of an enable mask is conditionalPasses[i]
+		std::vector<uint32_t> conditionalPasses;
+		std::unordered_map<uint32_t, Schedule> schedules;
+
+		// Scratch space for recording barriers, kept around so Execute doesn't allocate
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		std::vector<Memory::Image*> attachmentImages;
+		std::vector<VkRenderingAttachmentInfoKHR> renderingAttachments;
+
+		// Set when passes begin with vkCmdBeginRendering instead of going through the renderpass and framebuffer caches
+		const DynamicRendering* dynamicRendering = nullptr;
+
+		// Images created mid-run, moved to their resting layout at the start of the next frame
+		std::vector<VkImageMemoryBarrier> pendingTransitions;
+
+		ResolutionScaler resolutionScaler;
+		
+		// Level the dynamic images are currently using
+		uint32_t resolutionLevel = 0;
+
 	public:
 		std::string GetBackBuffer() const { return backBuffer.name; }
+		ResolutionScaler* GetResolutionScaler() { return &resolutionScaler; }
 		
 	public:
 		RenderGraph(Core* core);
@@ -52,11 +125,17 @@ namespace Renderer
 		ImageResource& GetImage(const std::string& name);
 		BufferResource& GetBuffer(const std::string& name);
 
+		// Blits source to the backbuffer, for rendering at a lower resolution than the swapchain
+		PassDesc& AddUpscalePass(const std::string& source);
+
 		void Build();
 		void Clear();
 
 		void Execute();
 
+		// Rebuild everything sized from the swapchain, the old images are retired while in-flight frames finish with them
+		void Resize();
+
 	private:
 
 		void CreateGraph(); // 1.  Create the DAG from a list of passes ( assert if cyclic )
@@ -66,6 +145,20 @@ namespace Renderer
 		
 		bool ValidateGraph(); // 2.  make sure backbuffer is written to, ensure read resources exist etc
 		void CreateResources(); // 3. create the resources, create sync objects.
+		void CreateSchedules(); // 4. compile the barrier schedules for each combination of conditional passes
+
+		// Point dynamic images at the scaler's current level
+		void UpdateResolution();
+
+		uint32_t GetEnableMask() const;
+		const Schedule& GetSchedule(uint32_t enableMask);
+		Schedule CompileSchedule(uint32_t enableMask);
+		
+		void RecordBarriers(VkCommandBuffer buffer, const std::vector<Barrier>& barriers, const FrameInfo& frameInfo);
+		// Dynamic rendering counterpart to FramebufferCache::BeginPass, renders into attachmentImages
+		void BeginRendering(VkCommandBuffer buffer, const ScheduledPass& scheduled, VkExtent2D extent);
+		Memory::Image* GetFrameImage(ImageResource* resource, const FrameInfo& frameInfo);
+		Resource* FindResource(const std::string& name);
 
 	};
 
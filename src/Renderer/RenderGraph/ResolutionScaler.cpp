@@ -0,0 +1,117 @@
+#include "ResolutionScaler.h"
+#include "../VulkanObjects/Device.h"
+#include "../../Utils/Logging.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Renderer
+{
+	ResolutionScaler::ResolutionScaler(Device* device, uint32_t framesInFlight)
+		: device(*device), pending(framesInFlight, false)
+	{
+		const auto limits = device->GetPhysicalDeviceProperties().limits;
+
+		timestampPeriod = limits.timestampPeriod;
+
+		// timestampComputeAndGraphics alone doesn't promise anything about the queue we're actually on
+		uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(*device->GetPhysicalDevice(), &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(*device->GetPhysicalDevice(), &familyCount, families.data());
+
+		const auto validBits = families[device->GetIndices()->graphicsFamily].timestampValidBits;
+		timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		supported = limits.timestampComputeAndGraphics && validBits != 0;
+
+		if (!supported)
+		{
+			LogWarning("Timestamps unsupported on the graphics queue, dynamic resolution stays at full scale");
+			return;
+		}
+
+		// A begin and end timestamp per frame in flight
+		VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = framesInFlight * 2;
+
+		const auto success = vkCreateQueryPool(this->device, &info, nullptr, &queryPool);
+		Assert(success == VK_SUCCESS, "Failed to create timestamp query pool");
+	}
+
+	ResolutionScaler::~ResolutionScaler()
+	{
+		if (queryPool) vkDestroyQueryPool(device, queryPool, nullptr);
+	}
+
+	void ResolutionScaler::BeginFrame(VkCommandBuffer buffer, uint32_t frameOffset)
+	{
+		if (!queryPool) return;
+
+		const auto first = frameOffset * 2;
+
+		// The frame fence for this slot has been waited on, so the results are already there
+		if (pending[frameOffset])
+		{
+			uint64_t timestamps[2];
+			const auto result = vkGetQueryPoolResults(device, queryPool, first, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+			// Only the valid bits count, the subtraction wraps within them if the counter rolled over
+			if (result == VK_SUCCESS) Update(static_cast<float>((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod * 1e-6f);
+		}
+
+		vkCmdResetQueryPool(buffer, queryPool, first, 2);
+		vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, first);
+	}
+
+	void ResolutionScaler::EndFrame(VkCommandBuffer buffer, uint32_t frameOffset)
+	{
+		if (!queryPool) return;
+
+		vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameOffset * 2 + 1);
+		pending[frameOffset] = true;
+	}
+
+	void ResolutionScaler::SetEnabled(bool enabled)
+	{
+		this->enabled = enabled && supported;
+
+		if (!this->enabled)
+		{
+			scale = maxScale;
+			level = static_cast<uint32_t>(std::round(maxScale * steps));
+		}
+	}
+
+	void ResolutionScaler::SetRange(float minScale, float maxScale)
+	{
+		Assert(minScale > 0.0f && minScale <= maxScale, "Invalid resolution scale range");
+
+		this->minScale = minScale;
+		this->maxScale = maxScale;
+
+		scale = std::clamp(scale, minScale, maxScale);
+		level = static_cast<uint32_t>(std::round(scale * steps));
+	}
+
+	void ResolutionScaler::Update(float frameMs)
+	{
+		// Smooth out single frame spikes
+		gpuMs = gpuMs == 0.0f ? frameMs : gpuMs * 0.9f + frameMs * 0.1f;
+
+		if (!enabled) return;
+
+		// Cost goes with pixel count, so the scale moves by the square root of how far off budget we are.
+		// Drop quickly when over budget, creep back up slowly
+		const auto ratio = std::sqrt(targetMs / std::max(gpuMs, 0.01f));
+		scale = std::clamp(scale * std::clamp(ratio, 0.9f, 1.02f), minScale, maxScale);
+
+		// Only switch level once we're well past the midpoint, otherwise we'd flip between two sizes every frame
+		const auto target = scale * steps;
+		if (std::abs(target - static_cast<float>(level)) > 0.75f)
+		{
+			level = std::max(static_cast<uint32_t>(std::round(target)), 1u);
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <vulkan.h>
+
+
+namespace Renderer
+{
+	class Device;
+
+	// Drives the scale of ImageSize::Dynamic images from the GPU time of the frame, measured with timestamps.
+	// The scale is quantised into levels so the graph can keep an image per level around instead of reallocating.
+	class ResolutionScaler
+	{
+		VkDevice device;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+
+		// Nanoseconds per timestamp tick
+		float timestampPeriod = 0.0f;
+		// The graphics queue's timestampValidBits, anything above is undefined
+		uint64_t timestampMask = 0;
+		bool supported = false;
+		bool enabled = false;
+
+		// Set once a slot has been written, reading a query which was never reset isn't allowed
+		std::vector<bool> pending;
+
+		float targetMs = 16.6f;
+		float gpuMs = 0.0f;
+
+		float scale = 1.0f;
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		uint32_t level = steps;
+
+		void Update(float frameMs);
+
+	public:
+		// Scale moves in increments of 1 / steps
+		static constexpr uint32_t steps = 8;
+
+		ResolutionScaler(Device* device, uint32_t framesInFlight);
+		~ResolutionScaler();
+
+		// Reads back the timings from the last time this slot was used, and starts timing this frame
+		void BeginFrame(VkCommandBuffer buffer, uint32_t frameOffset);
+		void EndFrame(VkCommandBuffer buffer, uint32_t frameOffset);
+
+		void SetEnabled(bool enabled);
+		void SetTarget(float milliseconds) { targetMs = milliseconds; }
+		void SetRange(float minScale, float maxScale);
+
+		bool IsEnabled() const { return enabled; }
+		float GetGpuTime() const { return gpuMs; }
+
+		uint32_t GetLevel() const { return level; }
+		float GetScale() const { return GetLevelScale(level); }
+		static float GetLevelScale(uint32_t level) { return static_cast<float>(level) / steps; }
+	};
+}
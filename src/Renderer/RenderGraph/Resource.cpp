@@ -1,6 +1,10 @@
 #include "Resource.h"
 #include "../Memory/Allocator.h"
+#include "../Memory/Buffer.h"
+#include "../Memory/Image.h"
 #include "RenderGraph.h"
+#include "ResolutionScaler.h"
+#include <algorithm>
 
 namespace Renderer
 {
@@ -34,6 +38,43 @@ namespace Renderer
 		return *this;
 	}
 
+	ImageInfo& ImageInfo::SetScale(float scale)
+	{
+		this->scale = scale;
+		return *this;
+	}
+
+	BufferResource::~BufferResource()
+	{
+		for(auto* buffer : buffers) delete buffer;
+	}
+
+	ImageResource::~ImageResource()
+	{
+		auto views = std::vector<VkImageView>();
+		auto extents = std::vector<VkExtent2D>();
+		Release(views, extents);
+	}
+
+	void ImageResource::Release(std::vector<VkImageView>& retiredViews, std::vector<VkExtent2D>& retiredExtents)
+	{
+		auto release = [&](const std::vector<Memory::Image*>& toRelease)
+		{
+			for(auto* image : toRelease)
+			{
+				retiredViews.push_back(image->GetView());
+				retiredExtents.push_back(image->GetExtent());
+				delete image;
+			}
+		};
+
+		if (scaledImages.empty()) release(images);
+		for(auto& [level, levelImages] : scaledImages) release(levelImages);
+
+		images.clear();
+		scaledImages.clear();
+	}
+
 	void BufferResource::Build(Memory::Allocator* allocator, VkExtent2D swapchainExtent, uint32_t framesInFlight)
 	{
 		buffers.resize(framesInFlight);
@@ -44,14 +85,50 @@ namespace Renderer
 		}
 	}
 
-	void ImageResource::Build(Memory::Allocator* allocator, VkExtent2D swapchainExtent, uint32_t framesInFlight)
+	bool ImageResource::IsDynamic() const
+	{
+		return info.sizeType == ImageSize::Dynamic;
+	}
+
+	VkExtent2D ImageResource::GetExtent(VkExtent2D swapchainExtent, float resolutionScale) const
+	{
+		switch (info.sizeType)
+		{
+			case ImageSize::Fixed:
+				return { (uint32_t)info.size.x, (uint32_t)info.size.y };
+			case ImageSize::SwapchainRelative: case ImageSize::Dynamic:
+			{
+				const auto scale = info.scale * (info.sizeType == ImageSize::Dynamic ? resolutionScale : 1.0f);
+				return { std::max(1u, (uint32_t)(swapchainExtent.width * scale)), std::max(1u, (uint32_t)(swapchainExtent.height * scale)) };
+			}
+			default:
+				return swapchainExtent;
+		}
+	}
+
+	void ImageResource::Build(Memory::Allocator* allocator, VkExtent2D swapchainExtent, uint32_t framesInFlight, float resolutionScale)
 	{
 		images.resize(framesInFlight);
 
+		const auto extent = GetExtent(swapchainExtent, resolutionScale);
+
 		for(auto i = 0; i < framesInFlight; i++)
 		{
-			images[i] = allocator->AllocateImage( info.sizeType == ImageSize::Swapchain ? swapchainExtent : 
-				VkExtent2D{ (uint32_t)info.size.x, (uint32_t)info.size.y }, info.format, info.usage,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			images[i] = allocator->AllocateImage(extent, info.format, info.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		}
+	}
+
+	bool ImageResource::UseLevel(uint32_t level, Memory::Allocator* allocator, VkExtent2D swapchainExtent, uint32_t framesInFlight)
+	{
+		auto [iter, inserted] = scaledImages.try_emplace(level);
+
+		if (inserted)
+		{
+			Build(allocator, swapchainExtent, framesInFlight, ResolutionScaler::GetLevelScale(level));
+			iter->second = images;
 		}
+		else images = iter->second;
+
+		return inserted;
 	}
 }
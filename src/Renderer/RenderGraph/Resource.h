@@ -2,6 +2,7 @@
 #include <glm/glm.hpp>
 #include <vulkan.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -33,11 +34,15 @@ namespace Renderer
 		uint32_t levels = 1;
 		uint32_t layers = 1;
 
+		// Fraction of the swapchain extent, used by ImageSize::SwapchainRelative and ImageSize::Dynamic
+		float scale = 1.0f;
+
 		ImageInfo& SetSize (glm::vec3 size);
 		ImageInfo& SetFormat (VkFormat format);
 		ImageInfo& SetLayout (VkImageLayout layout);
 		ImageInfo& SetUsage (VkImageUsageFlags usage);
 		ImageInfo& SetSizeType (ImageSize sizeType);
+		ImageInfo& SetScale (float scale);
 	};
 	
 	
@@ -62,6 +67,7 @@ namespace Renderer
 		std::vector<Usage> writes;
 
 		Resource(const std::string& name) : name(name) { }
+		virtual ~Resource() = default;
 		
 		void ReadBy(const Usage& usage) { reads.emplace_back(usage); }
 		void WrittenBy(const Usage& usage) { writes.emplace_back(usage); }
@@ -73,6 +79,7 @@ namespace Renderer
 		BufferInfo info;
 
 		BufferResource(const std::string& name) : Resource(name) {}
+		~BufferResource() override;
 
 		void SetInfo(BufferInfo info) { this->info = info; }
 
@@ -84,10 +91,24 @@ namespace Renderer
 		std::vector<Memory::Image*> images;
 		ImageInfo info;
 
+		// Dynamic images keep every resolution level they've been used at, images points into here
+		std::unordered_map<uint32_t, std::vector<Memory::Image*>> scaledImages;
+
 		ImageResource(const std::string& name) : Resource(name) {}
+		~ImageResource() override;
 
 		void SetInfo(ImageInfo info) { this->info = info; }
 
-		void Build(Memory::Allocator* allocator, VkExtent2D swapchainExtent, uint32_t framesInFlight);
+		bool IsDynamic() const;
+		VkExtent2D GetExtent(VkExtent2D swapchainExtent, float resolutionScale = 1.0f) const;
+
+		void Build(Memory::Allocator* allocator, VkExtent2D swapchainExtent, uint32_t framesInFlight, float resolutionScale = 1.0f);
+
+		// Switch to the images for a ResolutionScaler level, returns true if they had to be allocated
+		bool UseLevel(uint32_t level, Memory::Allocator* allocator, VkExtent2D swapchainExtent, uint32_t framesInFlight);
+
+		// Hands every image back to the allocator, their views and extents are added to retiredViews and retiredExtents
+		// so anything built on them can go too
+		void Release(std::vector<VkImageView>& retiredViews, std::vector<VkExtent2D>& retiredExtents);
 	};
 }
@@ -1,8 +1,9 @@
 #pragma once
+#include "../VulkanObjects/Cache.h"
 
 namespace Renderer
 {
-	class Sampler
+	class Sampler : public RefCounted
 	{
 	private:
 		VkSampler sampler;
@@ -12,7 +13,16 @@ namespace Renderer
 		Sampler& operator=(const Sampler&) = delete;
 		Sampler& operator=(Sampler&&) = delete;
 
-		Sampler(VkDevice* device, VkSamplerAddressMode addressMode, VkFilter filter, VkSamplerMipmapMode mipFilter) : device(device)
+		Sampler(VkDevice* device, const VkSamplerCreateInfo& samplerInfo) : device(device) { vkCreateSampler(*device, &samplerInfo, nullptr, &sampler); }
+
+		Sampler(VkDevice* device, VkSamplerAddressMode addressMode, VkFilter filter, VkSamplerMipmapMode mipFilter) : Sampler(device, CreateInfo(addressMode, filter, mipFilter)) { }
+
+		~Sampler() { if (device) vkDestroySampler(*device, sampler, nullptr); }
+
+		VkSampler getSampler() { return sampler; }
+
+		// The state the address mode, filter and mip filter constructor creates
+		static VkSamplerCreateInfo CreateInfo(VkSamplerAddressMode addressMode, VkFilter filter, VkSamplerMipmapMode mipFilter)
 		{
 			VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
 			samplerInfo.maxAnisotropy = 1.0f;
@@ -26,11 +36,7 @@ namespace Renderer
 			samplerInfo.minLod = -1000;
 			samplerInfo.maxLod = 1000;
 
-			vkCreateSampler(*device, &samplerInfo, nullptr, &sampler);
+			return samplerInfo;
 		}
-
-		~Sampler() { if (device) vkDestroySampler(*device, sampler, nullptr); }
-
-		VkSampler getSampler() { return sampler; }
 	};
 }
@@ -83,6 +83,7 @@ namespace Renderer
 		ShaderStatus status = ShaderStatus::Uninitialised;
 		std::vector<ShaderResources> resources;
 
+		std::string path;
 		std::string shaderText;
 		std::vector<uint32_t> spv;
 		uint32_t id;
@@ -90,17 +91,18 @@ namespace Renderer
 		bool glInitialised = false;
 
 	public:
-		Shader(ShaderType t, std::string path, uint32_t id) : type(t), id(id) { loadFromPath(t, path); }
+		Shader(ShaderType t, std::string path, uint32_t id) : type(t), path(path), id(id) { loadFromPath(t, path); }
 
 		bool loadFromPath(ShaderType t, std::string path);
 		const char* getText() const { return shaderText.c_str(); }
 
 		ShaderType getType() const { return type; }
+		const std::string& getPath() const { return path; }
 		ShaderStatus getStatus() const { return status; }
 
 		// For checking if a shader has already been compiled
 		uint32_t getSize() const { return static_cast<uint32_t>(spv.size() * 4); }
-		std::vector<ShaderResources> getResources() { return resources; }
+		const std::vector<ShaderResources>& getResources() const { return resources; }
 		std::vector<uint32_t>& getSPV() { return spv; }
 		const uint32_t getId() const { return id; }
 
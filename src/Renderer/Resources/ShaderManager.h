@@ -3,9 +3,36 @@
 #include <unordered_map>
 
 #include "ShaderProgram.h"
+#include "../VulkanObjects/Cache.h"
+
+namespace Renderer
+{
+	// The shaders of a program and everything its layouts are built with. Shaders are shared by type and path,
+	// so their ids say which source went in
+	struct ShaderProgramKey
+	{
+		std::vector<uint32_t> ids;
+		DescriptorSetLayout* bindlessLayout = nullptr;
+		bool pushDescriptors = false;
+
+		bool operator ==(const ShaderProgramKey& other) const { return ids == other.ids && bindlessLayout == other.bindlessLayout && pushDescriptors == other.pushDescriptors; }
+	};
+}
 
 namespace std
 {
+	template <>
+	struct hash<Renderer::ShaderProgramKey>
+	{
+		size_t operator()(const Renderer::ShaderProgramKey& s) const noexcept
+		{
+			size_t h1 = hash<uint64_t>{}(reinterpret_cast<uint64_t>(s.bindlessLayout)) ^ s.pushDescriptors;
+			for (auto id : s.ids) h1 ^= hash<uint32_t>{}(id) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+
+			return h1;
+		}
+	};
+
 	template <>
 	struct hash<std::pair<Renderer::ShaderType, std::string>>
 	{
@@ -15,6 +42,77 @@ namespace std
 
 namespace Renderer
 {
+	// Programs shared between everything asking for the same shaders and options. Pipelines and descriptor sets are cached
+	// by program, so sharing one is what lets them be shared too. Unreferenced programs go on Tick, once SetRetire has
+	// taken everything cached for them
+	class ShaderProgramCache : public RefCountedCache<ShaderProgram, ShaderProgramKey>
+	{
+	public:
+		void BuildCache(VkDevice* device, PipelineLayoutCache* layouts)
+		{
+			this->device = device;
+			this->layouts = layouts;
+		}
+
+		// Shared with anyone else asking for the same key, hand it back with Release
+		ShaderProgram* Acquire(const ShaderProgramKey& key, const std::vector<Shader*>& shaders)
+		{
+			auto* program = FindOrEmplace(key, device, shaders, layouts, key.bindlessLayout, key.pushDescriptors);
+			AddReference(program);
+
+			return program;
+		}
+
+		void Release(ShaderProgram* program)
+		{
+			RefCountedCache::Release(program);
+			if (!IsPinned(program)) retirePending = true;
+		}
+
+		// retire is handed each unreferenced program before it goes and retires what's cached for it, returning false to
+		// keep the program for now. Nothing goes until this is called
+		void SetRetire(std::function<bool(ShaderProgram*)> retire, Defer defer)
+		{
+			this->retire = std::move(retire);
+			this->defer = std::move(defer);
+		}
+
+		void Tick() override
+		{
+			RefCountedCache::Tick();
+			if (!retirePending || !retire) return;
+
+			// Only scanned after a release, anything retire turned down is tried again next time
+			retirePending = false;
+			stats.evictions += EvictIf([&](const ShaderProgramKey&, const Entry& entry)
+			{
+				if (retire(entry.value)) return true;
+
+				retirePending = true;
+				return false;
+			}, defer);
+		}
+
+		// nullptr unless it's been acquired before, the shaders aren't part of the key so nothing can be made here
+		ShaderProgram* Get(const ShaderProgramKey& key) override
+		{
+			auto* entry = cache.Find(key);
+			return entry ? entry->value : nullptr;
+		}
+
+		bool Add(const ShaderProgramKey& key) override { return false; }
+
+	private:
+		VkDevice* device;
+		PipelineLayoutCache* layouts;
+
+		std::function<bool(ShaderProgram*)> retire;
+		bool retirePending = false;
+
+		// Destroying the program is all there is to it
+		void ClearEntry(ShaderProgram* program) override { }
+	};
+
 	class ShaderManager
 	{
 	private:
@@ -25,8 +123,11 @@ namespace Renderer
 	public:
 		ShaderManager() {}
 
-		ShaderManager(VkDevice* device) : device(device)
+		// Programs take their layouts from layouts
+		ShaderManager(VkDevice* device, PipelineLayoutCache* layouts) : device(device)
 		{
+			programs.BuildCache(device, layouts);
+
 			shaders.emplace(defVert, new Shader(defVert.first, defVert.second, getId()));
 			shaders.emplace(defFrag, new Shader(defFrag.first, defFrag.second, getId()));
 			shaders.emplace(fsTri, new Shader(fsTri.first, fsTri.second, getId()));
@@ -34,6 +135,8 @@ namespace Renderer
 
 		~ShaderManager()
 		{
+			programs.ClearCache();
+
 			auto it = shaders.begin();
 
 			while (it != shaders.end())
@@ -56,12 +159,38 @@ namespace Renderer
 			return value;
 		}
 
-		ShaderProgram* getProgram(const std::vector<Shader*>& shaders) { return new ShaderProgram(device, shaders); }
+		// Shared with every other request for the same shaders in the same order, hand it back with releaseProgram. Once
+		// nothing holds it the program goes on Tick, along with its pipelines and descriptor sets
+		ShaderProgram* getProgram(const std::vector<Shader*>& shaders)
+		{
+			ShaderProgramKey key;
+			for (auto* shader : shaders) key.ids.push_back(shader->getId());
+			key.bindlessLayout = bindlessLayout;
+			key.pushDescriptors = pushDescriptors;
+
+			return programs.Acquire(key, shaders);
+		}
+
+		void releaseProgram(ShaderProgram* program) { programs.Release(program); }
+		const ShaderProgramCache& getPrograms() const { return programs; }
+
+		// See ShaderProgramCache::SetRetire
+		void SetRetire(std::function<bool(ShaderProgram*)> retire, ShaderProgramCache::Defer defer) { programs.SetRetire(std::move(retire), std::move(defer)); }
+		// Once per frame, unreferenced programs are retired here
+		void Tick() { programs.Tick(); }
+
+		// Programs made after this share set 0 with the bindless heap
+		void SetBindlessLayout(DescriptorSetLayout* layout) { bindlessLayout = layout; }
+		// Programs made after this get a push descriptor set, see ShaderProgram
+		void SetPushDescriptors(bool enabled) { pushDescriptors = enabled; }
 
 		uint32_t getId() { return uniqueId++; }
 
 		uint32_t uniqueId = 0;
 		std::unordered_map<std::pair<ShaderType, std::string>, Shader*> shaders;
 		VkDevice* device;
+		ShaderProgramCache programs;
+		DescriptorSetLayout* bindlessLayout = nullptr;
+		bool pushDescriptors = false;
 	};
 }
@@ -1,16 +1,45 @@
 #pragma once
+#include <algorithm>
 #include <vector>
 
 #include "Shader.h"
+#include "../VulkanObjects/BindlessHeap.h"
+#include "../VulkanObjects/DescriptorSet.h"
+#include "../VulkanObjects/LayoutCache.h"
+#include "../../Utils/Logging.h"
 
 namespace Renderer
 {
-	class ShaderProgram
+	// Sets by how often what's in them changes, numbered from ShaderProgram::getFirstSet. Binding a set leaves the ones before
+	// it alone, so while programs declare the lower sets identically per-frame globals stay bound as materials and draws change.
+	// Frame and Pass bindings are visible to every stage so the same declarations give the same layout in any program
+	enum class SetFrequency : uint32_t { Frame, Pass, Material, Draw, Count };
+
+	class ShaderProgram : public RefCounted
 	{
+
+		struct SetLayout
+		{
+			DescriptorSetLayout* layout = nullptr;
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+			std::vector<VkDescriptorPoolSize> poolSizes;
+			bool push = false;
+
+			VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+			std::vector<VkDescriptorUpdateTemplateEntry> templateEntries;
+			std::vector<std::pair<std::string, uint32_t>> templateSlots;
+			uint32_t templateSlotCount = 0;
+		};
+
 	public:
 		ShaderProgram() {}
 
-		ShaderProgram(VkDevice* device, std::vector<Shader*> shaders) : device(device)
+		// Each set the shaders declare gets a layout, see SetFrequency. Layouts come from layouts, so programs with the same
+		// interface share them and stay compatible. With a bindless layout the heap takes set 0
+		// and its push constant range, pushing every other set along by one. With pushDescriptors the Draw set is a
+		// VK_KHR_push_descriptor set, written straight into the command buffer through DescriptorSetCache::Push*
+		ShaderProgram(VkDevice* device, std::vector<Shader*> shaders, PipelineLayoutCache* layouts, DescriptorSetLayout* bindlessLayout = nullptr, bool pushDescriptors = false)
+			: device(device), layouts(layouts), bindlessLayout(bindlessLayout), pushDescriptors(pushDescriptors)
 		{
 			this->shaders = shaders;
 
@@ -21,7 +50,7 @@ namespace Renderer
 					shader->compileGLSL();
 					shader->reflectSPIRV();
 				}
-				auto res = shader->getResources();
+				const auto& res = shader->getResources();
 				shaderResources.insert(shaderResources.end(), res.begin(), res.end());
 
 				ids.push_back(shader->getId());
@@ -30,8 +59,13 @@ namespace Renderer
 
 		~ShaderProgram()
 		{
-			vkDestroyDescriptorSetLayout(*device, dLayout, nullptr);
-			vkDestroyPipelineLayout(*device, pLayout, nullptr);
+			for (auto& set : setLayouts)
+			{
+				if (set.updateTemplate != VK_NULL_HANDLE) vkDestroyDescriptorUpdateTemplate(*device, set.updateTemplate, nullptr);
+				if (set.layout) layouts->GetSetLayouts()->Release(set.layout);
+			}
+
+			if (initialised) layouts->Release(pipelineLayout);
 		}
 
 		bool operator ==(const ShaderProgram& other) const { return ids == other.ids; }
@@ -41,7 +75,9 @@ namespace Renderer
 			if (initialised) return;
 
 			std::vector<VkPushConstantRange> pushConstants;
-			std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+			// Always at least the Frame set, programs declaring nothing still get a layout to allocate from
+			setLayouts.resize(1);
 
 			for (const auto& shader : shaders)
 			{
@@ -53,6 +89,12 @@ namespace Renderer
 
 				for (const auto& resource : shader->getResources())
 				{
+					if (resource.type == VK_DESCRIPTOR_TYPE_MAX_ENUM && bindlessLayout != nullptr)
+					{
+						Assert(resource.offset + resource.size <= BindlessHeap::pushConstantSize, "Push constants don't fit the bindless range");
+						continue;
+					}
+
 					if (resource.type == VK_DESCRIPTOR_TYPE_MAX_ENUM)
 					{
 						// push constant (ref. Shader.cpp ~ line 400)
@@ -64,57 +106,147 @@ namespace Renderer
 						continue;
 					}
 
+					// Declared against the heap, it's bound once for everything
+					if (bindlessLayout != nullptr && resource.set == BindlessHeap::set) continue;
+
+					Assert(resource.set >= getFirstSet() && resource.set < getSetIndex(SetFrequency::Count), "Shader resource declared outside the frequency sets");
+
+					const auto index = resource.set - getFirstSet();
+					if (index >= setLayouts.size()) setLayouts.resize(index + 1);
+					auto& set = setLayouts[index];
+
+					// Stages sharing a binding share the descriptor
+					auto existing = std::find_if(set.bindings.begin(), set.bindings.end(), [&](const auto& binding) { return binding.binding == resource.binding; });
+					if (existing != set.bindings.end())
+					{
+						existing->stageFlags |= resource.flags;
+						continue;
+					}
+
 					VkDescriptorSetLayoutBinding binding = {};
 					binding.binding = resource.binding;
 					binding.descriptorCount = resource.descriptorCount;
 					binding.descriptorType = resource.type;
-					binding.stageFlags = resource.flags;
+					binding.stageFlags = index <= static_cast<uint32_t>(SetFrequency::Pass) ? VK_SHADER_STAGE_ALL : resource.flags;
+					set.bindings.push_back(binding);
+
+					if (isPushDescriptor(resource))
+					{
+						Assert(resource.type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC && resource.type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, "Push descriptor sets can't hold dynamic buffers");
+						set.push = true;
+						continue;
+					}
 
-					bindings.push_back(binding);
+					set.poolSizes.push_back({ resource.type, std::max(1u, resource.descriptorCount) });
+					set.templateSlots.emplace_back(resource.name, set.templateSlotCount);
 
-					if (resource.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || resource.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) { dynOffsets.emplace_back(0); }
+					VkDescriptorUpdateTemplateEntry entry = {};
+					entry.dstBinding = resource.binding;
+					entry.descriptorCount = std::max(1u, resource.descriptorCount);
+					entry.descriptorType = resource.type;
+					entry.offset = set.templateSlotCount * sizeof(DescriptorInfo);
+					entry.stride = sizeof(DescriptorInfo);
+					set.templateEntries.push_back(entry);
+
+					set.templateSlotCount += entry.descriptorCount;
 				}
 			}
 
-			VkDescriptorSetLayoutCreateInfo desclayout = {};
-			desclayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			desclayout.bindingCount = static_cast<uint32_t>(bindings.size());
-			desclayout.pBindings = bindings.data();
+			// Sets in between the ones declared get an empty layout, the pipeline layout can't have gaps
+			PipelineLayoutKey layoutKey;
+			if (bindlessLayout != nullptr) layoutKey.setLayouts.push_back(bindlessLayout);
+
+			for (auto& set : setLayouts)
+			{
+				if (set.push)
+				{
+					// 32 is the least any implementation allows
+					Assert(set.bindings.size() <= 32, "Too many bindings in the push descriptor set");
+				}
+
+				// Whichever order the shaders declared them in
+				DescriptorSetLayoutKey key;
+				key.flags = set.push ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
+				key.bindings = set.bindings;
+				std::sort(key.bindings.begin(), key.bindings.end(), [](const auto& a, const auto& b) { return a.binding < b.binding; });
 
-			vkCreateDescriptorSetLayout(*device, &desclayout, nullptr, &dLayout);
+				set.layout = layouts->GetSetLayouts()->Acquire(key);
+				layoutKey.setLayouts.push_back(set.layout);
 
-			VkPipelineLayoutCreateInfo layoutInfo = {};
-			layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-			layoutInfo.setLayoutCount = 1;
-			layoutInfo.pSetLayouts = &dLayout;
-			layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
-			layoutInfo.pPushConstantRanges = pushConstants.data();
+				if (set.templateEntries.empty()) continue;
+
+				VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+				templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+				templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(set.templateEntries.size());
+				templateInfo.pDescriptorUpdateEntries = set.templateEntries.data();
+				templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+				templateInfo.descriptorSetLayout = set.layout->GetLayout();
+
+				vkCreateDescriptorUpdateTemplate(*device, &templateInfo, nullptr, &set.updateTemplate);
+			}
 
-			vkCreatePipelineLayout(*device, &layoutInfo, nullptr, &pLayout);
+			if (bindlessLayout != nullptr) pushConstants = { { VK_SHADER_STAGE_ALL, 0, BindlessHeap::pushConstantSize } };
+
+			layoutKey.pushConstants = std::move(pushConstants);
+			pipelineLayout = layouts->Acquire(layoutKey);
 
 			initialised = true;
 		}
 
-		std::vector<Shader*> getShaders() const { return shaders; }
-		std::vector<ShaderResources> getResources() const { return shaderResources; }
+		const std::vector<Shader*>& getShaders() const { return shaders; }
+		const std::vector<ShaderResources>& getResources() const { return shaderResources; }
+
+		VkPipelineLayout getPipelineLayout() const { return pipelineLayout->GetLayout(); }
+		// Shared with every program declaring the same sets and push constants
+		const PipelineLayout* getSharedPipelineLayout() const { return pipelineLayout; }
+
+		// The set the Frame frequency is bound at, 1 when the bindless heap has 0. Draw is then set 4, which only devices
+		// binding more than the guaranteed 4 sets have
+		uint32_t getFirstSet() const { return bindlessLayout != nullptr ? BindlessHeap::set + 1 : 0; }
+		uint32_t getSetIndex(SetFrequency frequency) const { return getFirstSet() + static_cast<uint32_t>(frequency); }
 
-		VkPipelineLayout getPipelineLayout() const { return pLayout; }
-		VkDescriptorSetLayout getDescriptorLayout() const { return dLayout; }
+		// Whether resource is written with push descriptors rather than through a descriptor set
+		bool isPushDescriptor(const ShaderResources& resource) const { return pushDescriptors && resource.type != VK_DESCRIPTOR_TYPE_MAX_ENUM && resource.set == getSetIndex(SetFrequency::Draw); }
 
-		std::vector<uint32_t> getDynOffsets() { return dynOffsets; }
-		std::vector<uint32_t> getIds() const { return ids; }
+		// Everything below is valid once InitialiseResources has run. A frequency the shaders don't declare has an empty layout
+		// when something after it is declared, and nothing at all otherwise
+		bool hasSet(SetFrequency frequency) const { return static_cast<uint32_t>(frequency) < setLayouts.size(); }
+		bool isPushSet(SetFrequency frequency) const { return setLayouts[static_cast<uint32_t>(frequency)].push; }
+		VkDescriptorSetLayout getDescriptorLayout(SetFrequency frequency = SetFrequency::Frame) const { return setLayouts[static_cast<uint32_t>(frequency)].layout->GetLayout(); }
+
+		// Descriptors in one set of that frequency
+		const std::vector<VkDescriptorPoolSize>& getPoolSizes(SetFrequency frequency = SetFrequency::Frame) const { return setLayouts[static_cast<uint32_t>(frequency)].poolSizes; }
+
+		// Writes a whole set from getTemplateSlotCount() DescriptorInfos, VK_NULL_HANDLE when the set has no descriptors
+		VkDescriptorUpdateTemplate getUpdateTemplate(SetFrequency frequency = SetFrequency::Frame) const { return setLayouts[static_cast<uint32_t>(frequency)].updateTemplate; }
+		uint32_t getTemplateSlotCount(SetFrequency frequency = SetFrequency::Frame) const { return setLayouts[static_cast<uint32_t>(frequency)].templateSlotCount; }
+
+		// Where the resource's first descriptor goes in the array getUpdateTemplate reads
+		uint32_t getTemplateSlot(const std::string& name, SetFrequency frequency = SetFrequency::Frame) const
+		{
+			for (const auto& [resName, slot] : setLayouts[static_cast<uint32_t>(frequency)].templateSlots) { if (resName == name) return slot; }
+
+			Assert(false, "Failed to find shader resource in update template");
+			return 0;
+		}
+
+		const std::vector<uint32_t>& getIds() const { return ids; }
 
 	private:
 		bool initialised = false;
 
 		VkDevice* device;
-		VkPipelineLayout pLayout;
-		VkDescriptorSetLayout dLayout;
+		PipelineLayoutCache* layouts;
+		PipelineLayout* pipelineLayout = nullptr;
+		DescriptorSetLayout* bindlessLayout = nullptr;
+		bool pushDescriptors = false;
 
 		std::vector<Shader*> shaders;
 
 		std::vector<ShaderResources> shaderResources;
-		std::vector<uint32_t> dynOffsets;
+
+		// By frequency, as far as the last one declared
+		std::vector<SetLayout> setLayouts;
 		std::vector<uint32_t> ids;
 	};
 }
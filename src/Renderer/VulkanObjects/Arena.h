@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Renderer
+{
+	// Fixed size slabs of T, addresses stay put for as long as the object lives and freed slots are reused.
+	// Anything still alive when the arena goes is not destructed, destroy everything first
+	template <class T, size_t SlabSize = 64>
+	class Arena
+	{
+		struct Slab
+		{
+			alignas(T) std::byte storage[sizeof(T) * SlabSize];
+		};
+
+		std::vector<std::unique_ptr<Slab>> slabs;
+		std::vector<T*> freeSlots;
+
+	public:
+		Arena() = default;
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		template <class... Args>
+		T* Create(Args&&... args)
+		{
+			if (freeSlots.empty())
+			{
+				slabs.emplace_back(new Slab);
+
+				// Hand them out in address order
+				auto* first = reinterpret_cast<T*>(slabs.back()->storage);
+				for (size_t i = SlabSize; i-- > 0;) freeSlots.push_back(first + i);
+			}
+
+			T* slot = freeSlots.back();
+			freeSlots.pop_back();
+
+			return new (slot) T(std::forward<Args>(args)...);
+		}
+
+		void Destroy(T* object)
+		{
+			object->~T();
+			freeSlots.push_back(object);
+		}
+	};
+}
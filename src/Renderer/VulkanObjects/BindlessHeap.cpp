@@ -0,0 +1,180 @@
+#include "BindlessHeap.h"
+#include "Device.h"
+#include "LayoutCache.h"
+#include "../Memory/Allocator.h"
+#include "../Memory/Buffer.h"
+#include "../Memory/Image.h"
+#include "../Resources/Sampler.h"
+#include "../../Utils/Logging.h"
+#include <algorithm>
+
+namespace Renderer
+{
+	static constexpr VkDescriptorType descriptorTypes[] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLER };
+
+	BindlessHeap::BindlessHeap(Device* device, Memory::Allocator* allocator, PipelineLayoutCache* layouts) : device(*device), allocator(allocator), layouts(layouts)
+	{
+		// As many as we'd reasonably want, within what the device allows in an update-after-bind set and per stage
+		VkPhysicalDeviceDescriptorIndexingProperties limits = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+		VkPhysicalDeviceProperties2 properties2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+		properties2.pNext = &limits;
+		vkGetPhysicalDeviceProperties2(*device->GetPhysicalDevice(), &properties2);
+
+		slots[SampledImages].capacity = std::min({ 16384u, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+		slots[StorageImages].capacity = std::min({ 4096u, limits.maxDescriptorSetUpdateAfterBindStorageImages, limits.maxPerStageDescriptorUpdateAfterBindStorageImages });
+		slots[StorageBuffers].capacity = std::min({ 16384u, limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+		slots[Samplers].capacity = std::min({ 256u, limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+		DescriptorSetLayoutKey layoutKey;
+		layoutKey.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		VkDescriptorPoolSize poolSizes[BindingCount] = {};
+
+		for (uint32_t i = 0; i < BindingCount; i++)
+		{
+			VkDescriptorSetLayoutBinding binding = {};
+			binding.binding = i;
+			binding.descriptorType = descriptorTypes[i];
+			binding.descriptorCount = slots[i].capacity;
+			binding.stageFlags = VK_SHADER_STAGE_ALL;
+			layoutKey.bindings.push_back(binding);
+
+			// Slots nothing is registered in are never written, and writing one doesn't disturb command buffers already using the set
+			layoutKey.bindingFlags.push_back(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+
+			poolSizes[i] = { descriptorTypes[i], slots[i].capacity };
+		}
+
+		layout = layouts->GetSetLayouts()->Acquire(layoutKey);
+
+		// Only used to bind the set and push constants, it matches every bindless program's layout up to set 0
+		pipelineLayout = layouts->Acquire({ { layout }, { { VK_SHADER_STAGE_ALL, 0, pushConstantSize } } });
+
+		VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = BindingCount;
+		poolInfo.pPoolSizes = poolSizes;
+
+		auto success = vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &pool);
+		Assert(success == VK_SUCCESS, "Failed to create bindless descriptor pool");
+
+		VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		const auto setLayout = layout->GetLayout();
+		allocInfo.pSetLayouts = &setLayout;
+
+		success = vkAllocateDescriptorSets(this->device, &allocInfo, &descriptorSet);
+		Assert(success == VK_SUCCESS, "Failed to allocate bindless descriptor set");
+	}
+
+	BindlessHeap::~BindlessHeap()
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+		layouts->Release(pipelineLayout);
+		layouts->GetSetLayouts()->Release(layout);
+	}
+
+	std::pair<uint32_t, bool> BindlessHeap::Acquire(Binding binding, const void* resource)
+	{
+		auto& slot = slots[binding];
+
+		auto [index, inserted] = slot.indices.TryEmplace(resource);
+		if (!inserted) return { *index, false };
+
+		if (!slot.freeIndices.empty())
+		{
+			*index = slot.freeIndices.back();
+			slot.freeIndices.pop_back();
+		}
+		else
+		{
+			Assert(slot.next < slot.capacity, "Bindless heap is full");
+			*index = slot.next++;
+		}
+
+		return { *index, true };
+	}
+
+	void BindlessHeap::Write(Binding binding, uint32_t index, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo)
+	{
+		VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+		write.dstSet = descriptorSet;
+		write.dstBinding = binding;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = descriptorTypes[binding];
+		write.pImageInfo = imageInfo;
+		write.pBufferInfo = bufferInfo;
+
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+
+	uint32_t BindlessHeap::Register(Memory::Image* image, VkImageLayout imageLayout)
+	{
+		const auto [index, write] = Acquire(SampledImages, image);
+		if (!write) return index;
+
+		const VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, image->GetView(), imageLayout };
+		Write(SampledImages, index, &imageInfo, nullptr);
+
+		return index;
+	}
+
+	uint32_t BindlessHeap::RegisterStorage(Memory::Image* image)
+	{
+		const auto [index, write] = Acquire(StorageImages, image);
+		if (!write) return index;
+
+		const VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, image->GetView(), VK_IMAGE_LAYOUT_GENERAL };
+		Write(StorageImages, index, &imageInfo, nullptr);
+
+		return index;
+	}
+
+	uint32_t BindlessHeap::Register(Memory::Buffer* buffer)
+	{
+		const auto [index, write] = Acquire(StorageBuffers, buffer);
+		if (!write) return index;
+
+		const VkDescriptorBufferInfo bufferInfo = { buffer->GetResourceHandle(), 0, VK_WHOLE_SIZE };
+		Write(StorageBuffers, index, nullptr, &bufferInfo);
+
+		return index;
+	}
+
+	uint32_t BindlessHeap::Register(Sampler* sampler)
+	{
+		const auto [index, write] = Acquire(Samplers, sampler);
+		if (!write) return index;
+
+		const VkDescriptorImageInfo imageInfo = { sampler->getSampler(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+		Write(Samplers, index, &imageInfo, nullptr);
+
+		return index;
+	}
+
+	void BindlessHeap::Release(Binding binding, const void* resource)
+	{
+		auto& slot = slots[binding];
+
+		const auto* index = slot.indices.Find(resource);
+		if (!index) return;
+
+		// The slot keeps its stale descriptor, partially bound lets it sit there until it's handed out again
+		allocator->Defer([&slot, index = *index](VkDevice) { slot.freeIndices.push_back(index); });
+		slot.indices.Erase(resource);
+	}
+
+	void BindlessHeap::Bind(VkCommandBuffer buffer)
+	{
+		vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout->GetLayout(), set, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout->GetLayout(), set, 1, &descriptorSet, 0, nullptr);
+	}
+
+	void BindlessHeap::Push(VkCommandBuffer buffer, const void* data, uint32_t size, uint32_t offset)
+	{
+		Assert(offset + size <= pushConstantSize, "Push constants past the bindless range");
+		vkCmdPushConstants(buffer, pipelineLayout->GetLayout(), VK_SHADER_STAGE_ALL, offset, size, data);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "vulkan.h"
+#include <vector>
+#include "FlatMap.h"
+
+namespace Renderer
+{
+	class Device;
+	class Sampler;
+	class DescriptorSetLayout;
+	class PipelineLayout;
+	class PipelineLayoutCache;
+
+	namespace Memory
+	{
+		class Allocator;
+		class Buffer;
+		class Image;
+	}
+
+	// One update-after-bind, partially bound descriptor set holding every registered resource, bound once per command buffer at set 0.
+	// Resources get a stable index into their type's array which shaders pick up from push constants, so switching materials
+	// doesn't touch descriptors. Programs made while it exists keep their own descriptors in set 1, and every one shares
+	// the same push constant range so set 0 survives pipeline changes.
+	//
+	//   layout(set = 0, binding = 0) uniform texture2D textures[];
+	//   layout(set = 0, binding = 1, rgba8) uniform image2D images[];
+	//   layout(set = 0, binding = 2) buffer Buffers { uint data[]; } buffers[];
+	//   layout(set = 0, binding = 3) uniform sampler samplers[];
+	class BindlessHeap
+	{
+	public:
+		enum Binding : uint32_t { SampledImages, StorageImages, StorageBuffers, Samplers, BindingCount };
+
+		static constexpr uint32_t set = 0;
+		static constexpr uint32_t pushConstantSize = 128;
+
+	private:
+		struct Slots
+		{
+			FlatMap<const void*, uint32_t> indices;
+			std::vector<uint32_t> freeIndices;
+			uint32_t next = 0;
+			uint32_t capacity = 0;
+		};
+
+		VkDevice device;
+		Memory::Allocator* allocator;
+
+		PipelineLayoutCache* layouts;
+		DescriptorSetLayout* layout = nullptr;
+		PipelineLayout* pipelineLayout = nullptr;
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		Slots slots[BindingCount];
+
+		// The index for resource, and whether its descriptor still has to be written
+		std::pair<uint32_t, bool> Acquire(Binding binding, const void* resource);
+		void Write(Binding binding, uint32_t index, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo);
+
+	public:
+		// Both layouts come from layouts, which has to outlive the heap
+		BindlessHeap(Device* device, Memory::Allocator* allocator, PipelineLayoutCache* layouts);
+		~BindlessHeap();
+
+		BindlessHeap(const BindlessHeap&) = delete;
+		BindlessHeap& operator=(const BindlessHeap&) = delete;
+
+		DescriptorSetLayout* GetLayout() const { return layout; }
+
+		// Registering the same resource again hands back the index it already has
+		uint32_t Register(Memory::Image* image, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		uint32_t RegisterStorage(Memory::Image* image);
+		uint32_t Register(Memory::Buffer* buffer);
+		uint32_t Register(Sampler* sampler);
+
+		// The index is reused once the frames in flight which might still read it are done
+		void Release(Binding binding, const void* resource);
+
+		// Once at the start of a command buffer, stays bound for every pipeline made from a program with the heap's layout
+		void Bind(VkCommandBuffer buffer);
+		void Push(VkCommandBuffer buffer, const void* data, uint32_t size, uint32_t offset = 0);
+	};
+}
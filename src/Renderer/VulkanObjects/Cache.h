@@ -1,46 +1,259 @@
 #pragma once
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Arena.h"
+#include "FlatMap.h"
+#include "../../Utils/Logging.h"
 
 namespace Renderer
 {
+	struct CacheStats
+	{
+		size_t size = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+	};
+
 	// T is our type, for ex. Renderpass
 	// K is our key, for ex. RenderpassKey
 	template <class T, class K>
 	class Cache
 	{
+	public:
+		// Takes the destruction of an entry and runs it once no frame in flight can still be using it
+		using Defer = std::function<void(std::function<void()>)>;
+
 	protected:
-		std::unordered_map<K, T*> cache;
+		struct Entry
+		{
+			T* value = nullptr;
+			uint64_t lastUsed = 0;
+		};
+
+		// Values live in the arena so the pointers handed out stay valid while the table grows
+		FlatMap<K, Entry> cache;
+		Arena<T> arena;
 
 		uint16_t framesInFlight;
 		uint16_t currentFrame;
 
+		// Counts every Tick, entries remember the last one they were looked up in
+		uint64_t frame = 0;
+
+		// 0 turns either limit off
+		uint32_t maxAge = 0;
+		size_t budget = 0;
+		Defer defer;
+
+		// Entries only age out a frame at a time, so while the size holds the table is scanned every evictInterval ticks
+		static constexpr uint32_t evictInterval = 8;
+		uint64_t lastEvict = 0;
+		size_t lastEvictSize = 0;
+
+		// Kept between scans so going over budget doesn't allocate every time
+		std::vector<uint64_t> lastUsedScratch;
+
+		CacheStats stats;
+
 		virtual void ClearEntry(T*) = 0;
 
+		// Pinned entries are never evicted
+		virtual bool IsPinned(const T*) const { return false; }
+
 		Cache(uint16_t framesInFlight = 1)
 		{
 			this->framesInFlight = framesInFlight;
 			this->currentFrame = 0;
 		}
 
+		// Constructs the value for key in the arena from args, key must not already be in the cache
+		template <class... Args>
+		T* Emplace(const K& key, Args&&... args)
+		{
+			T* value = arena.Create(std::forward<Args>(args)...);
+			cache[key] = { value, frame };
+			++stats.misses;
+			return value;
+		}
+
+		// Looks key up, create() makes the value on a miss. Returns the value and whether it was created
+		template <class Create>
+		std::pair<T*, bool> TryCreate(const K& key, Create create)
+		{
+			// Hits are the common case, only a miss pays for the insertion checks
+			if (auto* found = cache.Find(key))
+			{
+				++stats.hits;
+				found->lastUsed = frame;
+				return { found->value, false };
+			}
+
+			auto [entry, inserted] = cache.TryEmplace(key);
+
+			if (inserted)
+			{
+				entry->value = create();
+				++stats.misses;
+			}
+			else ++stats.hits;
+
+			entry->lastUsed = frame;
+			return { entry->value, inserted };
+		}
+
+		// Looks key up, constructing it from args on a miss
+		template <class... Args>
+		T* FindOrEmplace(const K& key, Args&&... args)
+		{
+			return TryCreate(key, [&] { return arena.Create(std::forward<Args>(args)...); }).first;
+		}
+
+		// Removes every entry matching predicate(const K&, const Entry&), handing their destruction to defer. Pinned entries
+		// stay unless keepPinned is off
+		template <class Predicate>
+		uint32_t EvictIf(Predicate predicate, const Defer& defer, bool keepPinned = true)
+		{
+			return cache.EraseIf([&](const K& key, Entry& entry)
+			{
+				if ((keepPinned && IsPinned(entry.value)) || !predicate(key, entry)) return false;
+
+				auto* value = entry.value;
+				defer([this, value] { ClearEntry(value); arena.Destroy(value); });
+				return true;
+			});
+		}
+
+		void EvictOverBudget()
+		{
+			// Oldest first, but never anything used in the last frame, going over budget beats thrashing
+			auto excess = cache.Size() - budget;
+			lastUsedScratch.clear();
+			for (const auto& [key, entry] : cache) lastUsedScratch.push_back(entry.lastUsed);
+
+			std::nth_element(lastUsedScratch.begin(), lastUsedScratch.begin() + (excess - 1), lastUsedScratch.end());
+			const auto cutoff = std::min(lastUsedScratch[excess - 1], frame - 2);
+
+			stats.evictions += EvictIf([&](const K&, const Entry& entry)
+			{
+				if (excess == 0 || entry.lastUsed > cutoff) return false;
+
+				--excess;
+				return true;
+			}, defer);
+		}
+
+		void Evict()
+		{
+			if (!defer || (maxAge == 0 && budget == 0)) return;
+			if (cache.Size() == lastEvictSize && frame - lastEvict < evictInterval) return;
+
+			lastEvict = frame;
+
+			if (maxAge > 0) stats.evictions += EvictIf([&](const K&, const Entry& entry) { return frame - entry.lastUsed > maxAge; }, defer);
+			if (budget > 0 && cache.Size() > budget && frame >= 2) EvictOverBudget();
+
+			lastEvictSize = cache.Size();
+		}
+
 	public:
 		virtual bool Add(const K& key) = 0;
 		virtual T* Get(const K& key) = 0;
 		T* operator[](K key) { return Get(key); }
 
-		void ClearCache()
+		size_t Size() const { return cache.Size(); }
+
+		CacheStats GetStats() const
 		{
-			auto iter = cache.begin();
+			auto result = stats;
+			result.size = cache.Size();
+			return result;
+		}
+
+		// Entries not looked up for maxAge ticks, and the least recently used ones past budget entries, are evicted on Tick.
+		// Nothing is evicted until this is called. Either can take up to evictInterval ticks longer to be noticed
+		void SetEviction(uint32_t maxAge, size_t budget, Defer defer)
+		{
+			this->maxAge = maxAge;
+			this->budget = budget;
+			this->defer = std::move(defer);
+		}
 
-			while (iter != cache.end())
+		void ClearCache()
+		{
+			for (auto& [key, entry] : cache)
 			{
-				ClearEntry(iter->second);
-				delete iter->second;
-				++iter;
+				ClearEntry(entry.value);
+				arena.Destroy(entry.value);
 			}
 
-			cache.clear();
+			cache.Clear();
+		}
+
+		// Removes every entry matching predicate, defer is handed their destruction so in-flight frames can finish with them
+		template <class Predicate>
+		uint32_t Retire(Predicate predicate, const Defer& defer)
+		{
+			return EvictIf([&](const K& key, const Entry&) { return predicate(key); }, defer);
+		}
+
+		// Retire for pinned entries too, when what their keys point at is going away
+		template <class Predicate>
+		uint32_t Purge(Predicate predicate, const Defer& defer)
+		{
+			return EvictIf([&](const K& key, const Entry&) { return predicate(key); }, defer, false);
 		}
 
-		virtual void Tick() { currentFrame = (currentFrame + 1) % framesInFlight; }
+		// Once per frame, before anything is looked up
+		virtual void Tick()
+		{
+			currentFrame = (currentFrame + 1) % framesInFlight;
+			++frame;
+
+			Evict();
+		}
+	};
+
+	// Base for values a RefCountedCache hands out
+	class RefCounted
+	{
+		template <class T, class K>
+		friend class RefCountedCache;
+
+		uint32_t references = 0;
+	};
+
+	// Values shared between everyone asking for the same key, T derives from RefCounted. Acquired values stay alive until
+	// released, unreferenced ones are evicted like any other cache entry
+	template <class T, class K>
+	class RefCountedCache : public Cache<T, K>
+	{
+	public:
+		// Shared with anyone else asking for the same key, hand it back with Release
+		T* Acquire(const K& key)
+		{
+			auto* value = this->Get(key);
+			AddReference(value);
+
+			return value;
+		}
+
+		// Another reference to a value this cache handed out
+		void AddReference(T* value) { ++Counted(value)->references; }
+
+		void Release(T* value)
+		{
+			Assert(Counted(value)->references > 0, "Cache entry released more often than it was acquired");
+			--Counted(value)->references;
+		}
+
+	protected:
+		bool IsPinned(const T* value) const override { return Counted(value)->references > 0; }
+
+	private:
+		static RefCounted* Counted(T* value) { return value; }
+		static const RefCounted* Counted(const T* value) { return value; }
 	};
 }
@@ -0,0 +1,138 @@
+#include "DescriptorAllocator.h"
+#include "../../Utils/Logging.h"
+#include <algorithm>
+
+namespace Renderer
+{
+	void DescriptorAllocator::Initialise(VkDevice* device, uint32_t framesInFlight)
+	{
+		this->device = *device;
+		framePools.resize(framesInFlight);
+	}
+
+	void DescriptorAllocator::Destroy()
+	{
+		for (auto pool : pages) vkDestroyDescriptorPool(device, pool, nullptr);
+		for (auto& frame : framePools)
+		{
+			for (auto pool : frame.pools) vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+
+		pages.clear();
+		framePools.clear();
+	}
+
+	void DescriptorAllocator::Observe(const std::vector<VkDescriptorPoolSize>& sizes, uint32_t count)
+	{
+		for (const auto& size : sizes)
+		{
+			auto existing = std::find_if(observed.begin(), observed.end(), [&](const auto& other) { return other.first == size.type; });
+			if (existing == observed.end()) existing = observed.emplace(observed.end(), size.type, 0);
+
+			existing->second += static_cast<uint64_t>(size.descriptorCount) * count;
+		}
+
+		observedSets += count;
+	}
+
+	VkDescriptorPool DescriptorAllocator::CreatePool(uint32_t maxSets, const std::vector<VkDescriptorPoolSize>& sizes, uint32_t count, VkDescriptorPoolCreateFlags flags)
+	{
+		poolSizes.clear();
+
+		// Room for maxSets of the average set seen so far
+		for (const auto& [type, descriptors] : observed)
+		{
+			const auto average = static_cast<double>(descriptors) / static_cast<double>(std::max<uint64_t>(observedSets, 1));
+			poolSizes.push_back({ type, std::max(1u, static_cast<uint32_t>(average * maxSets + 0.5)) });
+		}
+
+		// And always enough for the request which caused it, however unusual it is
+		for (const auto& size : sizes)
+		{
+			auto& poolSize = *std::find_if(poolSizes.begin(), poolSizes.end(), [&](const VkDescriptorPoolSize& other) { return other.type == size.type; });
+			poolSize.descriptorCount = std::max(poolSize.descriptorCount, size.descriptorCount * count);
+		}
+
+		VkDescriptorPoolCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		createInfo.flags = flags;
+		createInfo.maxSets = std::max(maxSets, count);
+		createInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		createInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		const auto success = vkCreateDescriptorPool(device, &createInfo, nullptr, &pool);
+		Assert(success == VK_SUCCESS, "Failed to create descriptor pool");
+
+		return pool;
+	}
+
+	bool DescriptorAllocator::TryAllocate(VkDescriptorPool pool, const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* sets)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = count;
+		allocInfo.pSetLayouts = layouts;
+
+		const auto result = vkAllocateDescriptorSets(device, &allocInfo, sets);
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) return false;
+
+		Assert(result == VK_SUCCESS, "Failed to allocate descriptor sets");
+		return true;
+	}
+
+	VkDescriptorPool DescriptorAllocator::Allocate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& sizes, uint32_t count, VkDescriptorSet* sets)
+	{
+		Observe(sizes, count);
+
+		const auto layouts = std::vector<VkDescriptorSetLayout>(count, layout);
+
+		// Newest first, it's the one most likely to have room
+		for (auto page = pages.rbegin(); page != pages.rend(); ++page)
+		{
+			if (TryAllocate(*page, layouts.data(), count, sets)) return *page;
+		}
+
+		pages.push_back(CreatePool(setsPerPage, sizes, count, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT));
+		setsPerPage = std::min(setsPerPage * 2, maxSetsPerPage);
+
+		const auto success = TryAllocate(pages.back(), layouts.data(), count, sets);
+		Assert(success, "Failed to allocate descriptor sets from a new page");
+
+		return pages.back();
+	}
+
+	void DescriptorAllocator::Free(VkDescriptorPool pool, uint32_t count, const VkDescriptorSet* sets)
+	{
+		vkFreeDescriptorSets(device, pool, count, sets);
+	}
+
+	VkDescriptorSet DescriptorAllocator::AllocateTransient(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& sizes)
+	{
+		Observe(sizes, 1);
+
+		auto& frame = framePools[currentFrame];
+		VkDescriptorSet set;
+
+		for (; frame.current < frame.pools.size(); frame.current++)
+		{
+			if (TryAllocate(frame.pools[frame.current], &layout, 1, &set)) return set;
+		}
+
+		frame.pools.push_back(CreatePool(setsPerTransientPool, sizes, 1, 0));
+		setsPerTransientPool = std::min(setsPerTransientPool * 2, maxSetsPerPage);
+
+		const auto success = TryAllocate(frame.pools.back(), &layout, 1, &set);
+		Assert(success, "Failed to allocate a transient descriptor set from a new pool");
+
+		return set;
+	}
+
+	void DescriptorAllocator::BeginFrame(uint32_t frameOffset)
+	{
+		currentFrame = frameOffset;
+
+		auto& frame = framePools[currentFrame];
+		for (uint32_t i = 0; i < frame.pools.size() && i <= frame.current; i++) vkResetDescriptorPool(device, frame.pools[i], 0);
+		frame.current = 0;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "vulkan.h"
+#include <utility>
+#include <vector>
+
+namespace Renderer
+{
+	// Hands out descriptor sets from pools shared by every program, rather than a pool per program.
+	// Persistent sets come from pages split up in the ratio of descriptor types asked for so far, a bigger page is added
+	// whenever the existing ones run out. Transient sets come from pools owned by a frame in flight, which are reset in one go
+	// once that frame has retired.
+	class DescriptorAllocator
+	{
+		static constexpr uint32_t initialSetsPerPage = 64;
+		static constexpr uint32_t maxSetsPerPage = 4096;
+
+		struct FramePools
+		{
+			std::vector<VkDescriptorPool> pools;
+			uint32_t current = 0;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t currentFrame = 0;
+
+		// Newest last, freed sets go back to whichever page they came from
+		std::vector<VkDescriptorPool> pages;
+		uint32_t setsPerPage = initialSetsPerPage;
+
+		std::vector<FramePools> framePools;
+		uint32_t setsPerTransientPool = initialSetsPerPage;
+
+		// Descriptors of each type allocated so far, new pools are sized in the same ratio
+		std::vector<std::pair<VkDescriptorType, uint64_t>> observed;
+		uint64_t observedSets = 0;
+
+		// Scratch for CreatePool, kept so growing a transient pool mid-frame doesn't allocate once warmed up
+		std::vector<VkDescriptorPoolSize> poolSizes;
+
+		void Observe(const std::vector<VkDescriptorPoolSize>& sizes, uint32_t count);
+		VkDescriptorPool CreatePool(uint32_t maxSets, const std::vector<VkDescriptorPoolSize>& sizes, uint32_t count, VkDescriptorPoolCreateFlags flags);
+		bool TryAllocate(VkDescriptorPool pool, const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* sets);
+
+	public:
+		DescriptorAllocator() = default;
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+		void Initialise(VkDevice* device, uint32_t framesInFlight);
+		void Destroy();
+
+		// sizes holds the descriptors in a single set of layout. Returns the pool they came from, which Free needs back
+		VkDescriptorPool Allocate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& sizes, uint32_t count, VkDescriptorSet* sets);
+		void Free(VkDescriptorPool pool, uint32_t count, const VkDescriptorSet* sets);
+
+		// Only valid until this frame slot comes round again, never freed individually
+		VkDescriptorSet AllocateTransient(VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& sizes);
+
+		// Once the fence for frameOffset has been waited on, recycles every transient set it handed out
+		void BeginFrame(uint32_t frameOffset);
+	};
+}
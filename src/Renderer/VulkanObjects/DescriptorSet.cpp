@@ -1,132 +1,305 @@
 #include "DescriptorSet.h"
+#include "DescriptorAllocator.h"
+#include "UniformStream.h"
+#include "SamplerCache.h"
+#include "LayoutCache.h"
 #include "../Resources/ShaderProgram.h"
 #include "../../Utils/Logging.h"
 #include "../Memory/Allocator.h"
 #include "../Memory/Buffer.h"
 #include "../Memory/Image.h"
 #include "../Resources/Sampler.h"
+#include <tuple>
 
 namespace Renderer
 {
-	bool DescriptorSetKey::operator==(const DescriptorSetKey& other) const { return program == other.program; }
+	static_assert(std::size(DescriptorBindStats{}.binds) == static_cast<size_t>(SetFrequency::Count));
 
+	bool DescriptorResource::operator==(const DescriptorResource& other) const
+	{
+		return std::tie(binding, buffer, offset, range, image, sampler, layout) == std::tie(other.binding, other.buffer, other.offset, other.range, other.image, other.sampler, other.layout);
+	}
+
+	bool DescriptorSetKey::operator==(const DescriptorSetKey& other) const { return std::tie(program, frequency, signature, resources) == std::tie(other.program, other.frequency, other.signature, other.resources); }
+
+	DescriptorSetKey& DescriptorSetKey::Bind(const std::string& resName, Memory::Buffer* buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		DescriptorResource resource = {};
+		resource.buffer = buffer;
+		resource.offset = offset;
+		resource.range = range;
+
+		return Bind(resName, resource);
+	}
+
+	DescriptorSetKey& DescriptorSetKey::Bind(const std::string& resName, Memory::Image* image, Sampler* sampler, VkImageLayout layout)
+	{
+		DescriptorResource resource = {};
+		resource.image = image;
+		resource.sampler = sampler;
+		resource.layout = layout;
+
+		return Bind(resName, resource);
+	}
 
-	DescriptorSetBundle::DescriptorSetBundle(VkDevice* device, Memory::Allocator* allocator, DescriptorSetKey key, uint32_t framesInFlight) : framesInFlight(framesInFlight), resources(key.program->getResources()), device(device),
-	                                                                                                                                          allocator(allocator)
+	DescriptorSetKey& DescriptorSetKey::Bind(const std::string& resName, const DescriptorResource& resource)
 	{
-		std::vector<VkDescriptorPoolSize> poolSizes;
+		const auto& programResources = program->getResources();
+		const auto res = std::find_if(programResources.begin(), programResources.end(), [&](const ShaderResources& other) { return other.name == resName; });
+
+		Assert(res != programResources.end(), "Failed to find shader resource in descriptor set");
+		Assert(res->set == program->getSetIndex(frequency), "Shader resource is declared in another set");
+		Assert(res->type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC && res->type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, "Dynamic buffers aren't part of an instance");
+
+		auto position = std::find_if(resources.begin(), resources.end(), [&](const DescriptorResource& other) { return other.binding >= res->binding; });
+		if (position == resources.end() || position->binding != res->binding) position = resources.insert(position, resource);
+		else *position = resource;
+		position->binding = res->binding;
 
-		// initialise our pools
-		for (const auto& resource : key.program->getResources())
+		// Instances are built once and looked up often, so the whole signature is simply redone
+		signature = resources.size();
+		for (const auto& bound : resources)
 		{
-			if (resource.type == VK_DESCRIPTOR_TYPE_MAX_ENUM) continue; // this is a push constant
+			const uint64_t fields[] = { bound.binding, reinterpret_cast<uint64_t>(bound.buffer), bound.offset, bound.range, reinterpret_cast<uint64_t>(bound.image), reinterpret_cast<uint64_t>(bound.sampler), static_cast<uint64_t>(bound.layout) };
+			for (auto field : fields) signature ^= std::hash<uint64_t>{}(field) + 0x9e3779b9 + (signature << 6) + (signature >> 2);
+		}
+
+		return *this;
+	}
 
-			VkDescriptorPoolSize poolSize = {};
-			poolSize.type = resource.type;
-			poolSize.descriptorCount = framesInFlight;
+	void DescriptorWriter::Write(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const DescriptorInfo& info)
+	{
+		VkWriteDescriptorSet writeDescSet = {};
+		writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writeDescSet.dstSet = set;
+		writeDescSet.dstBinding = binding;
+		writeDescSet.dstArrayElement = 0;
+		writeDescSet.descriptorType = type;
+		writeDescSet.descriptorCount = 1;
+
+		writes.push_back(writeDescSet);
+		infos.push_back(info);
+	}
 
-			poolSizes.emplace_back(poolSize);
+	void DescriptorWriter::WriteBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo& info)
+	{
+		DescriptorInfo descriptorInfo;
+		descriptorInfo.buffer = info;
+		Write(set, binding, type, descriptorInfo);
+	}
+
+	void DescriptorWriter::WriteImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo& info)
+	{
+		DescriptorInfo descriptorInfo;
+		descriptorInfo.image = info;
+		Write(set, binding, type, descriptorInfo);
+	}
+
+	void DescriptorWriter::Flush(VkDevice device)
+	{
+		if (writes.empty()) return;
+
+		// The driver only reads whichever of the two matches the descriptor type
+		for (size_t i = 0; i < writes.size(); i++)
+		{
+			writes[i].pBufferInfo = &infos[i].buffer;
+			writes[i].pImageInfo = &infos[i].image;
 		}
 
-		VkDescriptorPoolCreateInfo poolCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-		poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolCreateInfo.pPoolSizes = poolSizes.data();
-		poolCreateInfo.maxSets = framesInFlight;
-		sets.resize(framesInFlight);
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 
-		auto success = vkCreateDescriptorPool(*device, &poolCreateInfo, nullptr, &pool);
-		Assert(success == VK_SUCCESS, "Failed to create descriptor pool");
+		writes.clear();
+		infos.clear();
+	}
 
-		std::vector<VkDescriptorSetLayout> layouts(framesInFlight, key.program->getDescriptorLayout());
 
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = pool;
-		allocInfo.descriptorSetCount = framesInFlight;
-		allocInfo.pSetLayouts = layouts.data();
+	DescriptorSetBundle::DescriptorSetBundle(VkDevice* device, Memory::Allocator* allocator, DescriptorAllocator* descriptorAllocator, DescriptorWriter* writer, UniformStream* stream, SamplerCache* samplerCache, const DescriptorSetKey& key, uint32_t framesInFlight)
+		: framesInFlight(framesInFlight), program(key.program), frequency(key.frequency), instance(!key.resources.empty()), device(device), allocator(allocator), descriptorAllocator(descriptorAllocator), writer(writer), stream(stream),
+		  samplerCache(samplerCache)
+	{
+		key.program->InitialiseResources(device);
+		Assert(key.program->hasSet(key.frequency), "Program declares no set of that frequency");
+		Assert(!key.program->isPushSet(key.frequency), "Push descriptor sets are never allocated");
+		updateTemplate = key.program->getUpdateTemplate(key.frequency);
+
+		// Just this set's, the bindless heap and push descriptors are bound some other way
+		const auto setIndex = key.program->getSetIndex(key.frequency);
+		for (const auto& item : key.program->getResources())
+		{
+			if (item.type != VK_DESCRIPTOR_TYPE_MAX_ENUM && item.set == setIndex && !key.program->isPushDescriptor(item)) resources.push_back(item);
+		}
 
-		sets.resize(framesInFlight);
-		success = vkAllocateDescriptorSets(*device, &allocInfo, sets.data());
-		Assert(success == VK_SUCCESS, "Failed to allocator descriptor sets");
+		// An instance is never rewritten, and a shared set of nothing but streamed uniforms is complete once this is done, the
+		// dynamic offsets pick each frame's data. Either way one set serves every frame unless a buffer needs a slice per frame
+		const bool slices = std::any_of(resources.begin(), resources.end(), [](const ShaderResources& res) { return res.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC; });
+		const bool streamedOnly = std::all_of(resources.begin(), resources.end(), [](const ShaderResources& res) { return res.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; });
+		const bool perFrame = slices || (!instance && !streamedOnly);
 
-		for(auto& item : key.program->getResources())
+		sets.resize(perFrame ? framesInFlight : 1);
+		pool = descriptorAllocator->Allocate(key.program->getDescriptorLayout(key.frequency), key.program->getPoolSizes(key.frequency), static_cast<uint32_t>(sets.size()), sets.data());
+
+		for(auto& item : resources)
 		{
-			auto size = std::max(256U, item.size);
 			switch(item.type)
 			{
-				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC: WriteBuffer(item.name, allocator->AllocateBuffer(size * framesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)); break;
-				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: WriteBuffer(item.name, allocator->AllocateBuffer(size * framesInFlight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)); break;
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+				{
+					// Stages sharing the binding share the descriptor
+					if (AddDynamicBinding(item, true)) WriteStream(item);
+					break;
+				}
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+					if (!AddDynamicBinding(item, false)) break;
+
+					WriteBuffer(item.name, allocator->AllocateBuffer(Stride(item) * framesInFlight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+					break;
 					default: LogError("Unsupported buffer type"); break;
 			}
 		}
+
+		for (const auto& resource : key.resources)
+		{
+			const auto res = *std::find_if(resources.begin(), resources.end(), [&](const ShaderResources& other) { return other.binding == resource.binding; });
+
+			if (resource.sampler != nullptr)
+			{
+				WriteSampler(res.name, resource.image, resource.sampler, resource.layout);
+				continue;
+			}
+
+			if (resource.image != nullptr)
+			{
+				const VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, resource.image->GetView(), resource.layout };
+				for (auto set : sets) writer->WriteImage(set, res.binding, res.type, imageInfo);
+				continue;
+			}
+
+			const VkDescriptorBufferInfo bufferInfo = { resource.buffer->GetResourceHandle(), resource.offset, resource.range };
+			for (auto set : sets) writer->WriteBuffer(set, res.binding, res.type, bufferInfo);
+		}
+
+		// Everything so far came from the key, and is written again if this is ever rebuilt
+		written = false;
+	}
+
+	VkDeviceSize DescriptorSetBundle::Stride(const ShaderResources& res) const
+	{
+		const auto alignment = stream->GetAlignment();
+		return (std::max<VkDeviceSize>(res.size, 1) + alignment - 1) & ~(alignment - 1);
+	}
+
+	DescriptorSetBundle::DynamicBinding* DescriptorSetBundle::FindDynamicBinding(const std::string& name)
+	{
+		for (auto& dynamic : dynamicBindings) { if (dynamic.name == name) return &dynamic; }
+
+		return nullptr;
+	}
+
+	bool DescriptorSetBundle::AddDynamicBinding(const ShaderResources& res, bool streamed)
+	{
+		auto position = std::find_if(dynamicBindings.begin(), dynamicBindings.end(), [&](const DynamicBinding& other) { return other.binding >= res.binding; });
+		if (position != dynamicBindings.end() && position->binding == res.binding) return false;
+
+		dynOffsets.insert(dynOffsets.begin() + (position - dynamicBindings.begin()), 0);
+		dynamicBindings.insert(position, { res.binding, res.name, streamed });
+		return true;
+	}
+
+	void DescriptorSetBundle::WriteStream(const ShaderResources& res)
+	{
+		VkDescriptorBufferInfo descBufferInfo = {};
+		descBufferInfo.buffer = stream->GetBuffer();
+		descBufferInfo.offset = 0;
+		descBufferInfo.range = std::max(1U, res.size);
+
+		for (auto set : sets) writer->WriteBuffer(set, res.binding, res.type, descBufferInfo);
+	}
+
+	void DescriptorSetBundle::SplitPerFrame()
+	{
+		if (instance || sets.size() == framesInFlight) return;
+
+		// Queued writes may still name the old set
+		writer->Flush(*device);
+
+		auto* descriptors = descriptorAllocator;
+		const auto oldPool = pool;
+		const auto oldSet = sets[0];
+		allocator->Defer([descriptors, oldPool, oldSet](VkDevice) { descriptors->Free(oldPool, 1, &oldSet); });
+
+		sets.resize(framesInFlight);
+		pool = descriptorAllocator->Allocate(program->getDescriptorLayout(frequency), program->getPoolSizes(frequency), framesInFlight, sets.data());
+
+		// Only streamed uniforms were in the old set
+		for (const auto& dynamic : dynamicBindings) WriteStream(GetShaderResource(dynamic.name));
 	}
 
 	void DescriptorSetBundle::WriteBuffer(const std::string& resName, Memory::Buffer* buffer)
 	{
-		buffers[resName] = buffer;
-		
+		SplitPerFrame();
+
 		const auto res = GetShaderResource(resName);
+		const auto stride = Stride(res);
+		written = true;
 
-		if (buffer->GetSize() < res.size * framesInFlight)
+		if (buffer->GetSize() < stride * framesInFlight)
 		{
 			auto usage = buffer->GetUsageFlags();
 			auto flags = buffer->GetMemoryFlags();
 			delete buffer;
-			buffer = allocator->AllocateBuffer(res.size * framesInFlight, usage, flags);
+			buffer = allocator->AllocateBuffer(stride * framesInFlight, usage, flags);
 		}
 
-		for (uint32_t i = 0; i < framesInFlight; i++)
+		buffers[resName] = buffer;
+
+		// Each frame's set has its own slice, so there's nothing to offset
+		if (auto* dynamic = FindDynamicBinding(resName))
 		{
-			std::vector<VkWriteDescriptorSet> writeSets;
+			dynamic->streamed = false;
+			dynOffsets[dynamic - dynamicBindings.data()] = 0;
+		}
 
+		for (uint32_t i = 0; i < sets.size(); i++)
+		{
 			VkDescriptorBufferInfo descBufferInfo = {};
 			descBufferInfo.buffer = buffer->GetResourceHandle();
-			descBufferInfo.offset = i * std::max(256U, res.size);
-			descBufferInfo.range = std::max(256U, res.size);
-
-			VkWriteDescriptorSet writeDescSet = {};
-			writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writeDescSet.dstSet = sets[i];
-			writeDescSet.dstBinding = res.binding;
-			writeDescSet.dstArrayElement = 0;
-			writeDescSet.descriptorType = res.type;
-			writeDescSet.descriptorCount = res.descriptorCount;
-			writeDescSet.pBufferInfo = &descBufferInfo;
+			descBufferInfo.offset = i * stride;
+			descBufferInfo.range = stride;
 
-			writeSets.push_back(writeDescSet);
-
-			vkUpdateDescriptorSets(*device, static_cast<uint32_t>(writeSets.size()), writeSets.data(), 0, nullptr);
+			writer->WriteBuffer(sets[i], res.binding, res.type, descBufferInfo);
 		}
 	}
 
 	void DescriptorSetBundle::WriteSampler(const std::string& resName, Memory::Image* image, Sampler* sampler, VkImageLayout layout)
 	{
+		SplitPerFrame();
 		const auto res = GetShaderResource(resName);
+		written = true;
 
 		VkDescriptorImageInfo imageInfo = {};
 		imageInfo.imageView = image->GetView();
-		images.emplace(resName, image);
+		images[resName] = image;
 		imageInfo.sampler = sampler->getSampler();
-		samplers.emplace(resName, sampler);
 		imageInfo.imageLayout = layout;
 
-		for (uint32_t i = 0; i < framesInFlight; i++)
-		{
-			std::vector<VkWriteDescriptorSet> writeSets;
+		samplerCache->AddReference(sampler);
+		auto& previous = samplers[resName];
+		if (previous) samplerCache->Release(previous);
+		previous = sampler;
 
-			VkWriteDescriptorSet writeDescSet = {};
-			writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writeDescSet.dstSet = sets[i];
-			writeDescSet.dstBinding = res.binding;
-			writeDescSet.dstArrayElement = 0;
-			writeDescSet.descriptorType = res.type;
-			writeDescSet.descriptorCount = res.descriptorCount;
-			writeDescSet.pImageInfo = &imageInfo;
+		for (auto set : sets) writer->WriteImage(set, res.binding, res.type, imageInfo);
+	}
 
-			writeSets.push_back(writeDescSet);
+	void DescriptorSetBundle::Update(const DescriptorInfo* infos)
+	{
+		Assert(updateTemplate != VK_NULL_HANDLE, "Program has no descriptors to update");
+		SplitPerFrame();
+		written = true;
 
-			vkUpdateDescriptorSets(*device, static_cast<uint32_t>(writeSets.size()), writeSets.data(), 0, nullptr);
-		}
+		// Anything queued for these sets would otherwise land on top of the update
+		writer->Flush(*device);
+
+		for (auto set : sets) vkUpdateDescriptorSetWithTemplate(*device, set, updateTemplate, infos);
 	}
 
 	ShaderResources DescriptorSetBundle::GetShaderResource(const std::string& resName) const
@@ -137,20 +310,52 @@ namespace Renderer
 		return ShaderResources{};
 	}
 
-	void* DescriptorSetBundle::GetResource(const std::string& name, uint32_t offset) { return buffers[name]->Map(); }
+	void* DescriptorSetBundle::GetResource(const std::string& name, uint32_t frame)
+	{
+		const auto res = GetShaderResource(name);
+
+		auto* dynamic = FindDynamicBinding(name);
+		if (dynamic && dynamic->streamed)
+		{
+			const auto [data, offset] = stream->Allocate(res.size);
+			dynOffsets[dynamic - dynamicBindings.data()] = offset;
+			return data;
+		}
+
+		// Whatever the caller puts there is gone if the bundle is
+		written = true;
+		return buffers[name]->Map() + Stride(res) * frame;
+	}
 
-	void DescriptorSetBundle::SetResource(const std::string& name, void* data, const size_t size, const size_t offset)
+	void DescriptorSetBundle::SetResource(const std::string& name, void* data, const size_t size, const size_t frame)
 	{
-		buffers[name]->Load(data, size, std::max(size * offset, 256 * offset));
+		auto* dynamic = FindDynamicBinding(name);
+		if (dynamic && dynamic->streamed)
+		{
+			dynOffsets[dynamic - dynamicBindings.data()] = stream->Push(data, size);
+			return;
+		}
+
+		written = true;
+		buffers[name]->Load(data, size, Stride(GetShaderResource(name)) * frame);
 	}
 
 
-	void DescriptorSetBundle::Clear() { for (auto& val : samplers) { delete val.second; } }
+	void DescriptorSetBundle::Clear()
+	{
+		// Queued writes may still name these sets
+		writer->Flush(*device);
+		descriptorAllocator->Free(pool, static_cast<uint32_t>(sets.size()), sets.data());
+		for (auto& val : samplers) { samplerCache->Release(val.second); }
+	}
 
-	void DescriptorSetCache::BuildCache(VkDevice* device, Memory::Allocator* allocator, uint32_t framesInFlight)
+	void DescriptorSetCache::BuildCache(VkDevice* device, Memory::Allocator* allocator, DescriptorAllocator* descriptorAllocator, UniformStream* stream, SamplerCache* samplerCache, uint32_t framesInFlight)
 	{
 		this->device = device;
 		this->allocator = allocator;
+		this->descriptorAllocator = descriptorAllocator;
+		this->stream = stream;
+		this->samplerCache = samplerCache;
 		this->framesInFlight = framesInFlight;
 	}
 
@@ -168,39 +373,185 @@ namespace Renderer
 		descBundle->WriteSampler(resName, image, sampler, layout);
 	}
 
-	void DescriptorSetCache::SetResource(const DescriptorSetKey& key, std::string resName, void* data, size_t size)
+	void DescriptorSetCache::WriteSampler(DescriptorSetKey& key, const std::string& resName, Memory::Image* image, const VkSamplerCreateInfo& samplerInfo, VkImageLayout layout)
+	{
+		auto* sampler = samplerCache->Acquire(samplerInfo);
+
+		// The bundle takes a reference of its own
+		WriteSampler(key, resName, image, sampler, layout);
+		samplerCache->Release(sampler);
+	}
+
+	void DescriptorSetCache::SetResource(const DescriptorSetKey& key, const std::string& resName, void* data, size_t size)
 	{
 		auto descSet = Get(key);
 
 		descSet->SetResource(resName, data, size, currentFrame);
 	}
 
+	void DescriptorSetCache::Update(const DescriptorSetKey& key, const DescriptorInfo* infos)
+	{
+		auto descSet = Get(key);
+
+		descSet->Update(infos);
+	}
+
+	void DescriptorSetCache::Flush()
+	{
+		writer.Flush(*device);
+	}
+
 	void DescriptorSetCache::BindDescriptorSet(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, const DescriptorSetKey& key)
 	{
 		auto descSet = Get(key);
+		writer.Flush(*device);
+
+		const auto& dynOffsets = descSet->GetDynamicOffsets();
+		const auto* layout = key.program->getSharedPipelineLayout();
+		const auto setIndex = key.program->getSetIndex(key.frequency);
+		auto* set = descSet->Get(currentFrame);
 
-		vkCmdBindDescriptorSets(buffer, bindPoint, key.program->getPipelineLayout(), 0, 1, descSet->Get(currentFrame), static_cast<uint32_t>(key.program->getDynOffsets().size()), key.program->getDynOffsets().data());
+		if (auto* bound = GetBoundSets(buffer, bindPoint))
+		{
+			if (setIndex < bound->size())
+			{
+				const auto& current = (*bound)[setIndex];
+				if (current.set == *set && current.dynOffsets == dynOffsets && current.layout->IsCompatible(layout, setIndex))
+				{
+					bindStats.skipped++;
+					return;
+				}
+			}
+
+			Disturb(*bound, layout, setIndex);
+
+			auto& current = (*bound)[setIndex];
+			current.layout = layout;
+			current.set = *set;
+			current.dynOffsets.assign(dynOffsets.begin(), dynOffsets.end());
+		}
+
+		bindStats.binds[static_cast<uint32_t>(key.frequency)]++;
+		vkCmdBindDescriptorSets(buffer, bindPoint, layout->GetLayout(), setIndex, 1, set, static_cast<uint32_t>(dynOffsets.size()), dynOffsets.data());
+	}
+
+	std::vector<DescriptorSetCache::BoundSet>* DescriptorSetCache::GetBoundSets(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint)
+	{
+		if (bindPoint != VK_PIPELINE_BIND_POINT_GRAPHICS && bindPoint != VK_PIPELINE_BIND_POINT_COMPUTE) return nullptr;
+
+		if (buffer != boundBuffer)
+		{
+			boundBuffer = buffer;
+			ResetBoundSets();
+		}
+
+		return &boundSets[bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE];
+	}
+
+	void DescriptorSetCache::ResetBoundSets()
+	{
+		for (auto& bound : boundSets)
+		{
+			for (auto& set : bound) set.Reset();
+		}
+	}
+
+	void DescriptorSetCache::Disturb(std::vector<BoundSet>& bound, const PipelineLayout* layout, uint32_t set)
+	{
+		bound.resize(std::max<size_t>(bound.size(), set + 1));
+
+		// Sets on either side survive only if the layouts agree up to them
+		for (uint32_t i = 0; i < bound.size(); i++)
+		{
+			if (i == set || bound[i].layout == nullptr || bound[i].layout->IsCompatible(layout, i)) continue;
+			bound[i].Reset();
+		}
+
+		bound[set].Reset();
+	}
+
+	void DescriptorSetCache::Push(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, ShaderProgram* program, const std::string& resName, const DescriptorInfo& info)
+	{
+		Assert(pushDescriptorSet != nullptr, "Push descriptors are not enabled");
+		program->InitialiseResources(device);
+
+		const auto& resources = program->getResources();
+		const auto res = std::find_if(resources.begin(), resources.end(), [&](const ShaderResources& other) { return other.name == resName; });
+		Assert(res != resources.end() && program->isPushDescriptor(*res), "Resource is not in the program's push descriptor set");
+
+		bindStats.pushes++;
+		if (auto* bound = GetBoundSets(buffer, bindPoint)) Disturb(*bound, program->getSharedPipelineLayout(), program->getSetIndex(SetFrequency::Draw));
+
+		VkWriteDescriptorSet writeDescSet = {};
+		writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writeDescSet.dstBinding = res->binding;
+		writeDescSet.dstArrayElement = 0;
+		writeDescSet.descriptorType = res->type;
+		writeDescSet.descriptorCount = 1;
+		writeDescSet.pBufferInfo = &info.buffer;
+		writeDescSet.pImageInfo = &info.image;
+
+		pushDescriptorSet(buffer, bindPoint, program->getPipelineLayout(), program->getSetIndex(SetFrequency::Draw), 1, &writeDescSet);
+	}
+
+	void DescriptorSetCache::PushBuffer(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, ShaderProgram* program, const std::string& resName, Memory::Buffer* resource, VkDeviceSize offset, VkDeviceSize range)
+	{
+		DescriptorInfo info;
+		info.buffer = { resource->GetResourceHandle(), offset, range };
+
+		Push(buffer, bindPoint, program, resName, info);
+	}
+
+	void DescriptorSetCache::PushImage(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, ShaderProgram* program, const std::string& resName, Memory::Image* image, Sampler* sampler, VkImageLayout layout)
+	{
+		DescriptorInfo info;
+		info.image = { sampler != nullptr ? sampler->getSampler() : VK_NULL_HANDLE, image->GetView(), layout };
+
+		Push(buffer, bindPoint, program, resName, info);
+	}
+
+	VkDescriptorSet DescriptorSetCache::AllocateTransient(ShaderProgram* program, SetFrequency frequency)
+	{
+		program->InitialiseResources(device);
+		Assert(program->hasSet(frequency), "Program declares no set of that frequency");
+		Assert(!program->isPushSet(frequency), "Push descriptor sets are never allocated");
+
+		return descriptorAllocator->AllocateTransient(program->getDescriptorLayout(frequency), program->getPoolSizes(frequency));
+	}
+
+	void DescriptorSetCache::Tick()
+	{
+		lastBindStats = bindStats;
+		bindStats = {};
+
+		// Sets may be freed from here on, and command buffers are begun again
+		boundBuffer = VK_NULL_HANDLE;
+		ResetBoundSets();
+
+		Cache::Tick();
 	}
 
 	DescriptorSetBundle* DescriptorSetCache::Get(const DescriptorSetKey& key)
 	{
-		auto& descriptorSet = cache[key];
-		if (!descriptorSet) { descriptorSet = new DescriptorSetBundle(device, allocator, key, framesInFlight); }
-		return descriptorSet;
+		return FindOrEmplace(key, device, allocator, descriptorAllocator, &writer, stream, samplerCache, key, framesInFlight);
 	}
 
 	bool DescriptorSetCache::Add(const DescriptorSetKey& key)
 	{
-		if (cache.find(key) != cache.end()) return false;
+		if (cache.Contains(key)) return false;
 
-		cache.emplace(key, new DescriptorSetBundle(device, allocator, key, framesInFlight));
+		Emplace(key, device, allocator, descriptorAllocator, &writer, stream, samplerCache, key, framesInFlight);
 
 		return true;
 	}
 
+	void DescriptorSetCache::RetireProgram(ShaderProgram* program, const Defer& defer)
+	{
+		Purge([program](const DescriptorSetKey& key) { return key.program == program; }, defer);
+	}
+
 	void DescriptorSetCache::ClearEntry(DescriptorSetBundle* set)
 	{
-		vkDestroyDescriptorPool(*device, set->GetPool(), nullptr);
 		set->Clear();
 	}
 }
@@ -1,4 +1,6 @@
 #pragma once
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <vulkan.h>
 
@@ -9,6 +11,7 @@ namespace Renderer
 {
 	struct ShaderResources;
 	class ShaderProgram;
+	enum class SetFrequency : uint32_t;
 
 	namespace Memory
 	{
@@ -18,34 +21,124 @@ namespace Renderer
 	}
 
 	class Sampler;
+	class PipelineLayout;
+	class DescriptorAllocator;
+	class UniformStream;
+	class SamplerCache;
+
+	// One slot of the packed array an update template reads, whichever kind of descriptor its binding holds
+	union DescriptorInfo
+	{
+		VkDescriptorImageInfo image;
+		VkDescriptorBufferInfo buffer;
+		VkBufferView texelBuffer;
+	};
+
+	// Collects descriptor writes from any number of sets so they reach the driver in one vkUpdateDescriptorSets
+	class DescriptorWriter
+	{
+		std::vector<VkWriteDescriptorSet> writes;
+		// One per write, the pointers are only filled in on Flush since this grows
+		std::vector<DescriptorInfo> infos;
+
+		void Write(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const DescriptorInfo& info);
+
+	public:
+		void WriteBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo& info);
+		void WriteImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo& info);
+
+		bool Empty() const { return writes.empty(); }
+		void Flush(VkDevice device);
+	};
+
+	// A resource a material instance has bound, the caller keeps it alive for as long as the instance is used.
+	// Samplers come from the SamplerCache
+	struct DescriptorResource
+	{
+		uint32_t binding;
+		Memory::Buffer* buffer = nullptr;
+		VkDeviceSize offset = 0;
+		VkDeviceSize range = VK_WHOLE_SIZE;
+		Memory::Image* image = nullptr;
+		Sampler* sampler = nullptr;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		bool operator ==(const DescriptorResource& other) const;
+	};
 
 	struct DescriptorSetKey
 	{
 		ShaderProgram* program;
+		// Which of the program's sets this is, Frame when left alone
+		SetFrequency frequency{};
+
+		// Empty for the program's shared set of that frequency. Otherwise a material instance, a set written once with these resources
+		// and shared by every key binding the same ones. Sorted by binding
+		std::vector<DescriptorResource> resources;
+		size_t signature = 0;
+
+		// Build an instance up by resource name, dynamic buffers stay with SetResource. The resource has to be in the key's set
+		DescriptorSetKey& Bind(const std::string& resName, Memory::Buffer* buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		DescriptorSetKey& Bind(const std::string& resName, Memory::Image* image, Sampler* sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		bool operator ==(const DescriptorSetKey& other) const;
+
+	private:
+		DescriptorSetKey& Bind(const std::string& resName, const DescriptorResource& resource);
 	};
 
 	class DescriptorSetBundle
 	{
 	public:
-		DescriptorSetBundle(VkDevice* device, Memory::Allocator* allocator, DescriptorSetKey key, uint32_t framesInFlight);
+		// Dynamic uniform buffers are pointed at stream, everything else dynamic gets a buffer of its own
+		DescriptorSetBundle(VkDevice* device, Memory::Allocator* allocator, DescriptorAllocator* descriptorAllocator, DescriptorWriter* writer, UniformStream* stream, SamplerCache* samplerCache, const DescriptorSetKey& key, uint32_t framesInFlight);
 
+		// Queued on the writer, they land when it's next flushed. A dynamic buffer written here stops streaming,
+		// each frame gets its own aligned slice of buffer instead
 		void WriteBuffer(const std::string& resName, Memory::Buffer* buffer);
 
+		// sampler comes from the SamplerCache, the bundle holds its own reference until it's replaced or cleared
 		void WriteSampler(const std::string& resName, Memory::Image* image, Sampler* sampler, VkImageLayout layout);
+
+		// Rewrites every frame's set in one driver call each through the program's update template,
+		// infos is laid out as ShaderProgram::getTemplateSlot describes
+		void Update(const DescriptorInfo* infos);
 		ShaderResources GetShaderResource(const std::string& resName) const;
 
-		VkDescriptorSet* Get(uint32_t offset) { return &sets[offset]; }
+		// Instances without per-frame buffers, and shared sets holding only streamed uniforms, have the one set for every frame
+		VkDescriptorSet* Get(uint32_t offset) { return &sets[sets.size() == 1 ? 0 : offset]; }
+
+		// Shared with other bundles, the sets go back to it when this is cleared
 		VkDescriptorPool GetPool() { return pool; }
 
-		void* GetResource(const std::string& name, uint32_t offset);
-		void SetResource(const std::string& name, void* data, size_t size, size_t offset);
+		// Only a material instance nothing was written to by hand can be evicted, it's rebuilt from its key just as it was.
+		// Anything else would come back without what was written
+		bool IsPinned() const { return !instance || written; }
+
+		// For a streamed uniform both hand out a fresh slice of this frame's stream, which the next bind picks up,
+		// so the same set can be bound for any number of draws with different data. Otherwise frame's slice of the buffer
+		void* GetResource(const std::string& name, uint32_t frame);
+		void SetResource(const std::string& name, void* data, size_t size, size_t frame);
+
+		// One per dynamic binding in binding order, as vkCmdBindDescriptorSets wants them
+		const std::vector<uint32_t>& GetDynamicOffsets() const { return dynOffsets; }
 
 		void Clear();
 
 	private:
+		struct DynamicBinding
+		{
+			uint32_t binding;
+			std::string name;
+			bool streamed;
+		};
+
 		uint32_t framesInFlight;
+		ShaderProgram* program;
+		SetFrequency frequency;
+		bool instance;
+		// Through any of the writes above rather than from the key
+		bool written = false;
 		std::vector<ShaderResources> resources;
 		VkDevice* device;
 		Memory::Allocator* allocator;
@@ -53,6 +146,25 @@ namespace Renderer
 		std::unordered_map<std::string, Memory::Image*> images;
 		std::unordered_map<std::string, Sampler*> samplers;
 
+		DescriptorAllocator* descriptorAllocator;
+		DescriptorWriter* writer;
+		UniformStream* stream;
+		SamplerCache* samplerCache;
+		VkDescriptorUpdateTemplate updateTemplate;
+
+		// Sorted by binding, dynOffsets runs parallel
+		std::vector<DynamicBinding> dynamicBindings;
+		std::vector<uint32_t> dynOffsets;
+
+		// Bytes between one frame's slice of a buffer and the next
+		VkDeviceSize Stride(const ShaderResources& res) const;
+		DynamicBinding* FindDynamicBinding(const std::string& name);
+		bool AddDynamicBinding(const ShaderResources& res, bool streamed);
+		// Points every set's binding at the whole stream, the dynamic offset picks the slice
+		void WriteStream(const ShaderResources& res);
+		// A shared set starting out as one for every frame gets one per frame before it's written to by hand, in-flight
+		// frames may still be reading the one it had
+		void SplitPerFrame();
 		std::vector<VkDescriptorSet> sets;
 		VkDescriptorPool pool;
 	};
@@ -63,42 +175,129 @@ namespace std
 	template <>
 	struct hash<Renderer::DescriptorSetKey>
 	{
-		size_t operator()(const Renderer::DescriptorSetKey& s) const noexcept { return hash<uint64_t>{}(reinterpret_cast<uint64_t>(s.program)); }
+		size_t operator()(const Renderer::DescriptorSetKey& s) const noexcept
+		{
+			size_t h1 = hash<uint64_t>{}(reinterpret_cast<uint64_t>(s.program));
+			h1 ^= static_cast<size_t>(s.frequency) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+			h1 ^= s.signature + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+
+			return h1;
+		}
 	};
 }
 
 namespace Renderer
 {
+	// Binds recorded over the last frame, by SetFrequency. With the sets split by frequency the Frame count should stay
+	// at about one per pass while Material and Draw follow the draw calls
+	struct DescriptorBindStats
+	{
+		uint32_t binds[4] = {};
+		uint32_t pushes = 0;
+		// Binds left out since the set was already bound under a compatible pipeline layout
+		uint32_t skipped = 0;
+	};
+
 	class DescriptorSetCache : public Cache<DescriptorSetBundle, DescriptorSetKey>
 	{
 	private:
 		VkDevice* device;
 		Memory::Allocator* allocator;
+		DescriptorAllocator* descriptorAllocator;
+		UniformStream* stream;
+		SamplerCache* samplerCache;
+
+		// Shared by every bundle, flushed before any set is bound
+		DescriptorWriter writer;
+
+		PFN_vkCmdPushDescriptorSetKHR pushDescriptorSet = nullptr;
+
+		DescriptorBindStats bindStats;
+		DescriptorBindStats lastBindStats;
+
+		struct BoundSet
+		{
+			const PipelineLayout* layout = nullptr;
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			std::vector<uint32_t> dynOffsets;
+
+			// Keeps dynOffsets' storage, so binding again doesn't allocate
+			void Reset()
+			{
+				layout = nullptr;
+				set = VK_NULL_HANDLE;
+				dynOffsets.clear();
+			}
+		};
+
+		// What the cache has bound in the command buffer being recorded, by set number, for graphics and compute.
+		// Anything bound around the cache isn't seen, and recording another command buffer starts over. Entries are
+		// reset rather than removed, once every set number has been seen tracking binds stops allocating
+		VkCommandBuffer boundBuffer = VK_NULL_HANDLE;
+		std::vector<BoundSet> boundSets[2];
+
+		// nullptr for bind points which aren't tracked
+		std::vector<BoundSet>* GetBoundSets(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint);
+		void ResetBoundSets();
+		// Forgets whatever binding at set with layout disturbs
+		static void Disturb(std::vector<BoundSet>& bound, const PipelineLayout* layout, uint32_t set);
+
+		void Push(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, ShaderProgram* program, const std::string& resName, const DescriptorInfo& info);
 
 	public:
-		void BuildCache(VkDevice* device, Memory::Allocator* allocator, uint32_t framesInFlight);
+		void BuildCache(VkDevice* device, Memory::Allocator* allocator, DescriptorAllocator* descriptorAllocator, UniformStream* stream, SamplerCache* samplerCache, uint32_t framesInFlight);
 
 		void WriteBuffer(DescriptorSetKey& key, const std::string& resName, Memory::Buffer* buffer);
 
 		void WriteSampler(DescriptorSetKey& key, const std::string& resName, Memory::Image* image, Sampler* sampler, VkImageLayout layout);
+		// The sampler for samplerInfo is looked up in the SamplerCache
+		void WriteSampler(DescriptorSetKey& key, const std::string& resName, Memory::Image* image, const VkSamplerCreateInfo& samplerInfo, VkImageLayout layout);
 
 		template <typename T>
-		T* GetResource(const DescriptorSetKey& key, std::string resName);
+		T* GetResource(const DescriptorSetKey& key, const std::string& resName);
 
-		void SetResource(const DescriptorSetKey& key, std::string resName, void* data, size_t size);
+		void SetResource(const DescriptorSetKey& key, const std::string& resName, void* data, size_t size);
 
+		void Update(const DescriptorSetKey& key, const DescriptorInfo* infos);
+
+		// Hands every queued write to the driver at once, binding does this itself
+		void Flush();
+
+		// At the set number key.frequency has in the program, sets bound before it stay bound as long as the layouts match.
+		// Left out when the same set and offsets are still bound under a compatible layout
 		void BindDescriptorSet(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, const DescriptorSetKey& key);
 
+		const DescriptorBindStats& GetBindStats() const { return lastBindStats; }
+
+		// From Device::GetPushDescriptorSet, nullptr leaves push descriptors off
+		void SetPushDescriptorSet(PFN_vkCmdPushDescriptorSetKHR pushDescriptorSet) { this->pushDescriptorSet = pushDescriptorSet; }
+		bool IsPushDescriptorEnabled() const { return pushDescriptorSet != nullptr; }
+
+		// Recorded straight into buffer, no set, pool or update involved. resName has to be in the program's Draw set,
+		// and stays bound until pushed again or the pipeline layout changes
+		void PushBuffer(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, ShaderProgram* program, const std::string& resName, Memory::Buffer* resource, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void PushImage(VkCommandBuffer buffer, VkPipelineBindPoint bindPoint, ShaderProgram* program, const std::string& resName, Memory::Image* image, Sampler* sampler, VkImageLayout layout);
+
+		// An unwritten set of frequency for program from this frame's pools, only valid until this frame slot comes round again
+		VkDescriptorSet AllocateTransient(ShaderProgram* program, SetFrequency frequency);
+
+		// Every set of program's goes, written by hand or not, nothing can bind them without it
+		void RetireProgram(ShaderProgram* program, const Defer& defer);
+
+		// Also rolls the bind statistics over
+		void Tick() override;
+
 		DescriptorSetBundle* Get(const DescriptorSetKey& key) override;
 		bool Add(const DescriptorSetKey& key) override;
 
 	private:
 
 		void ClearEntry(DescriptorSetBundle* set) override;
+		bool IsPinned(const DescriptorSetBundle* set) const override { return set->IsPinned(); }
 	};
 
 	template <typename T>
-	T* DescriptorSetCache::GetResource(const DescriptorSetKey& key, std::string resName)
+	T* DescriptorSetCache::GetResource(const DescriptorSetKey& key, const std::string& resName)
 	{
 		auto descSet = Get(key);
 
@@ -1,6 +1,7 @@
 #include "Device.h"
 
 #include "glfw3.h"
+#include <algorithm>
 #include <set>
 #include <string>
 #include "../../Utils/Logging.h"
@@ -74,10 +75,18 @@ namespace Renderer
 		vkDestroyInstance(instance, nullptr);
 	}
 
-	void Device::BuildInstance(bool debugLayers)
+	void Device::BuildInstance(bool debugLayers, bool headless)
 	{
 		this->debug = debugLayers;
+		this->headless = headless;
 
+		if (headless)
+		{
+			// Nothing will be presented, so don't require a driver which can
+			auto& physExtensions = extensions.physExtensions;
+			physExtensions.erase(std::remove_if(physExtensions.begin(), physExtensions.end(), [](const char* extension) { return std::string(extension) == VK_KHR_SWAPCHAIN_EXTENSION_NAME; }), physExtensions.end());
+		}
+		else
 		{
 			// Get our required glfw extensions
 			uint32_t glfwExtensionCount = 0;
@@ -163,6 +172,7 @@ namespace Renderer
 	{
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.transferFamily, indices.computeFamily };
+		uniqueQueueFamilies.erase(-1); // Not every family exists, headless has no present family
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -178,8 +188,49 @@ namespace Renderer
 
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 
+		// Optional features which were requested and found, chained onto the create info
+		void* features = nullptr;
+
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT };
+		extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+		if (extendedDynamicStateEnabled)
+		{
+			extendedDynamicStateFeatures.pNext = features;
+			features = &extendedDynamicStateFeatures;
+		}
+
+		VkPhysicalDeviceImagelessFramebufferFeatures imagelessFramebufferFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES };
+		imagelessFramebufferFeatures.imagelessFramebuffer = VK_TRUE;
+		if (imagelessFramebufferEnabled)
+		{
+			imagelessFramebufferFeatures.pNext = features;
+			features = &imagelessFramebufferFeatures;
+		}
+
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR };
+		dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+		if (dynamicRenderingEnabled)
+		{
+			dynamicRenderingFeatures.pNext = features;
+			features = &dynamicRenderingFeatures;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+		descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		if (descriptorIndexingEnabled)
+		{
+			descriptorIndexingFeatures.pNext = features;
+			features = &descriptorIndexingFeatures;
+		}
+
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceCreateInfo.pNext = features;
 		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(uniqueQueueFamilies.size());
 		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
@@ -201,11 +252,28 @@ namespace Renderer
 		Assert(success == VK_SUCCESS, "Failed to create logical device");
 
 		vkGetDeviceQueue(device, indices.graphicsFamily, 0, &queues.graphics);
-		vkGetDeviceQueue(device, indices.presentFamily, 0, presentQueue);
+		if (indices.presentFamily != -1) vkGetDeviceQueue(device, indices.presentFamily, 0, presentQueue);
 
 		if (indices.transferFamily != -1) vkGetDeviceQueue(device, indices.transferFamily, 0, &queues.transfer);
 		else LogInfo("Seperate transfer command queues not supported");
 
+		if (extendedDynamicStateEnabled)
+		{
+			extendedDynamicState.setCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT");
+			extendedDynamicState.setPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT");
+			extendedDynamicState.setDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT");
+			extendedDynamicState.setDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT");
+			extendedDynamicState.setDepthCompareOp = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT");
+		}
+
+		if (dynamicRenderingEnabled)
+		{
+			dynamicRendering.beginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+			dynamicRendering.endRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+		}
+
+		if (pushDescriptorEnabled) pushDescriptorSet = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
+
 		LogInfo("Using Physical Device: {}", props.deviceName);
 		LogInfo("	- Vender API version: {}", props.apiVersion);
 		LogInfo("	- Driver version:  {}", props.driverVersion);
@@ -219,6 +287,118 @@ namespace Renderer
 	}
 
 
+	bool Device::IsExtensionAvailable(const char* extension)
+	{
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(physDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		return std::any_of(availableExtensions.begin(), availableExtensions.end(), [extension](const VkExtensionProperties& properties) { return std::string(properties.extensionName) == extension; });
+	}
+
+	bool Device::RequestExtendedDynamicState()
+	{
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supported = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT };
+		if (IsExtensionAvailable(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME))
+		{
+			VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supported;
+			vkGetPhysicalDeviceFeatures2(physDevice, &features2);
+		}
+
+		if (!supported.extendedDynamicState)
+		{
+			LogInfo("Extended dynamic state not supported, depth and topology stay in the pipeline");
+			return false;
+		}
+
+		extensions.physExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+		extendedDynamicStateEnabled = true;
+		return true;
+	}
+
+	bool Device::RequestImagelessFramebuffer()
+	{
+		// Core since 1.2, which is what the instance asks for
+		VkPhysicalDeviceImagelessFramebufferFeatures supported = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES };
+		if (properties.apiVersion >= VK_API_VERSION_1_2)
+		{
+			VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supported;
+			vkGetPhysicalDeviceFeatures2(physDevice, &features2);
+		}
+
+		if (!supported.imagelessFramebuffer)
+		{
+			LogInfo("Imageless framebuffers not supported, framebuffers are made per set of views");
+			return false;
+		}
+
+		imagelessFramebufferEnabled = true;
+		return true;
+	}
+
+	bool Device::RequestDynamicRendering()
+	{
+		// The extension's dependencies, create_renderpass2 and depth_stencil_resolve, are core in 1.2
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR supported = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR };
+		if (properties.apiVersion >= VK_API_VERSION_1_2 && IsExtensionAvailable(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+		{
+			VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supported;
+			vkGetPhysicalDeviceFeatures2(physDevice, &features2);
+		}
+
+		if (!supported.dynamicRendering)
+		{
+			LogInfo("Dynamic rendering not supported, passes go through renderpasses and framebuffers");
+			return false;
+		}
+
+		extensions.physExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		dynamicRenderingEnabled = true;
+		return true;
+	}
+
+	bool Device::RequestDescriptorIndexing()
+	{
+		// Core since 1.2
+		VkPhysicalDeviceDescriptorIndexingFeatures supported = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+		if (properties.apiVersion >= VK_API_VERSION_1_2)
+		{
+			VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supported;
+			vkGetPhysicalDeviceFeatures2(physDevice, &features2);
+		}
+
+		const bool complete = supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound && supported.shaderSampledImageArrayNonUniformIndexing &&
+			supported.descriptorBindingSampledImageUpdateAfterBind && supported.descriptorBindingStorageImageUpdateAfterBind && supported.descriptorBindingStorageBufferUpdateAfterBind;
+
+		if (!complete)
+		{
+			LogInfo("Descriptor indexing not supported, bindless resources are unavailable");
+			return false;
+		}
+
+		descriptorIndexingEnabled = true;
+		return true;
+	}
+
+	bool Device::RequestPushDescriptor()
+	{
+		// No feature bit, the extension is all there is
+		if (!IsExtensionAvailable(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME))
+		{
+			LogInfo("Push descriptors not supported, programs can't use a push descriptor set");
+			return false;
+		}
+
+		extensions.physExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		pushDescriptorEnabled = true;
+		return true;
+	}
+
 	QueueFamilyIndices Device::GetIndices(VkPhysicalDevice physDevice, VkSurfaceKHR* surface)
 	{
 		QueueFamilyIndices indices;
@@ -245,7 +425,7 @@ namespace Renderer
 		for (const auto& queueFamily : queueFamilies)
 		{
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(physDevice, i, *surface, &presentSupport);
+			if (surface != nullptr) vkGetPhysicalDeviceSurfaceSupportKHR(physDevice, i, *surface, &presentSupport);
 
 			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphicsFamily = i;
 			if (queueFamily.queueCount && queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) indices.computeFamily = i;
@@ -307,6 +487,8 @@ namespace Renderer
 		QueueFamilyIndices indices = GetIndices(physDevice, surface);
 
 		bool extensionsSupported = CheckDeviceExtensionSupport(physDevice);
+		if (surface == nullptr) return physDeviceFeatures.geometryShader && indices.isComplete(false) && extensionsSupported;
+
 		bool swapChainSupport = false;
 		if (extensionsSupported)
 		{
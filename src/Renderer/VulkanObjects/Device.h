@@ -13,7 +13,24 @@ namespace Renderer
 		int transferFamily = -1;
 		int computeFamily = -1;
 
-		bool isComplete() const { return graphicsFamily >= 0 && presentFamily >= 0; }
+		bool isComplete(bool present = true) const { return graphicsFamily >= 0 && (!present || presentFamily >= 0); }
+	};
+
+	// VK_EXT_extended_dynamic_state entry points, loaded when the extension was enabled
+	struct ExtendedDynamicState
+	{
+		PFN_vkCmdSetCullModeEXT setCullMode = nullptr;
+		PFN_vkCmdSetPrimitiveTopologyEXT setPrimitiveTopology = nullptr;
+		PFN_vkCmdSetDepthTestEnableEXT setDepthTestEnable = nullptr;
+		PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable = nullptr;
+		PFN_vkCmdSetDepthCompareOpEXT setDepthCompareOp = nullptr;
+	};
+
+	// VK_KHR_dynamic_rendering entry points, loaded when the extension was enabled
+	struct DynamicRendering
+	{
+		PFN_vkCmdBeginRenderingKHR beginRendering = nullptr;
+		PFN_vkCmdEndRenderingKHR endRendering = nullptr;
 	};
 
 	class Device
@@ -54,8 +71,18 @@ namespace Renderer
 		VkInstance instance;
 		VkDebugUtilsMessengerEXT debugMessenger;
 		bool debug = false;
+		bool headless = false;
 		QueueFamilyIndices indices;
 
+		bool extendedDynamicStateEnabled = false;
+		ExtendedDynamicState extendedDynamicState;
+		bool imagelessFramebufferEnabled = false;
+		bool dynamicRenderingEnabled = false;
+		DynamicRendering dynamicRendering;
+		bool descriptorIndexingEnabled = false;
+		PFN_vkCmdPushDescriptorSetKHR pushDescriptorSet = nullptr;
+		bool pushDescriptorEnabled = false;
+
 		// physical device details
 		VkPhysicalDeviceFeatures features;
 		VkPhysicalDeviceProperties properties;
@@ -65,21 +92,41 @@ namespace Renderer
 		VkPhysicalDevice* GetPhysicalDevice() { return &physDevice; }
 		VkInstance* GetInstance() { return &instance; }
 		QueueFamilyIndices* GetIndices() { return &indices; }
+		bool IsHeadless() const { return headless; }
+
+		// nullptr unless RequestExtendedDynamicState succeeded
+		const ExtendedDynamicState* GetExtendedDynamicState() const { return extendedDynamicStateEnabled ? &extendedDynamicState : nullptr; }
+		bool IsImagelessFramebufferEnabled() const { return imagelessFramebufferEnabled; }
+		// nullptr unless RequestDynamicRendering succeeded
+		const DynamicRendering* GetDynamicRendering() const { return dynamicRenderingEnabled ? &dynamicRendering : nullptr; }
+		bool IsDescriptorIndexingEnabled() const { return descriptorIndexingEnabled; }
+		// nullptr unless RequestPushDescriptor succeeded
+		PFN_vkCmdPushDescriptorSetKHR GetPushDescriptorSet() const { return pushDescriptorEnabled ? pushDescriptorSet : nullptr; }
 
 		VkPhysicalDeviceFeatures GetPhysicalDeviceFeatures() { return features; }
 		VkPhysicalDeviceProperties GetPhysicalDeviceProperties() { return properties; }
 		VkPhysicalDeviceMemoryProperties GetPhysicalDeviceMemoryProperties() { return memProperties; }
 
 
-		void BuildInstance(bool debugLayers);
+		// Headless skips every window system extension, and surface/present queries are skipped when the surface is null
+		void BuildInstance(bool debugLayers, bool headless = false);
 		void PickPhysicalDevice(VkSurfaceKHR* surface);
 		void BuildLogicalDevice(VkQueue* presentQueue);
+
+		// Between picking the physical device and building the logical one. False if the device doesn't support it
+		bool RequestExtendedDynamicState();
+		bool RequestImagelessFramebuffer();
+		bool RequestDynamicRendering();
+		// Just what the BindlessHeap needs, partially bound update-after-bind runtime arrays of images and storage buffers
+		bool RequestDescriptorIndexing();
+		bool RequestPushDescriptor();
 		
 	private:
 		// Physical Device related functions
 		QueueFamilyIndices GetIndices(VkPhysicalDevice physDevice, VkSurfaceKHR* surface);
 
 		bool CheckDeviceExtensionSupport(VkPhysicalDevice physDevice);
+		bool IsExtensionAvailable(const char* extension);
 		void CheckSwapChainSupport(VkPhysicalDevice physDevice, VkSurfaceKHR* surface, VkSurfaceCapabilitiesKHR* capabilities, std::vector<VkSurfaceFormatKHR>& formats, std::vector<VkPresentModeKHR>& presentModes);
 
 		bool IsDeviceSuitable(VkPhysicalDevice physDevice, VkSurfaceKHR* surface, VkSurfaceCapabilitiesKHR* capabilities, std::vector<VkSurfaceFormatKHR>& formats, std::vector<VkPresentModeKHR>& presentModes);
@@ -0,0 +1,196 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace Renderer
+{
+	// Open addressing hash map with linear probing. Slots only hold the full hash and an index into a dense
+	// entry array, so probing touches one small array and a miss rarely has to compare keys.
+	// Erasing moves the last entry into the gap, pointers and references to entries don't survive an erase or insert.
+	template <class K, class V, class Hash = std::hash<K>>
+	class FlatMap
+	{
+		static constexpr uint32_t empty = ~0u;
+		static constexpr uint32_t tombstone = ~0u - 1;
+		static constexpr uint32_t minCapacity = 16;
+
+		struct Slot
+		{
+			size_t hash = 0;
+			uint32_t index = empty;
+		};
+
+		std::vector<Slot> slots;
+		std::vector<std::pair<K, V>> entries;
+		std::vector<size_t> hashes; // Parallel to entries
+		uint32_t tombstones = 0;
+
+		// std::hash is the identity for integers and pointers, spread it out before masking
+		static size_t Mix(size_t hash)
+		{
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		uint32_t Mask() const { return static_cast<uint32_t>(slots.size()) - 1; }
+
+		// Slot holding key, or empty if it isn't in the map
+		uint32_t FindSlot(const K& key, size_t hash) const
+		{
+			if (slots.empty()) return empty;
+
+			for (uint32_t i = static_cast<uint32_t>(hash) & Mask();; i = (i + 1) & Mask())
+			{
+				const auto& slot = slots[i];
+				if (slot.index == empty) return empty;
+				if (slot.index != tombstone && slot.hash == hash && entries[slot.index].first == key) return i;
+			}
+		}
+
+		void Rehash(uint32_t capacity)
+		{
+			slots.assign(capacity, Slot{});
+			tombstones = 0;
+
+			for (uint32_t index = 0; index < entries.size(); index++)
+			{
+				uint32_t i = static_cast<uint32_t>(hashes[index]) & Mask();
+				while (slots[i].index != empty) i = (i + 1) & Mask();
+
+				slots[i] = { hashes[index], index };
+			}
+		}
+
+		void EraseSlot(uint32_t slotIndex)
+		{
+			const auto index = slots[slotIndex].index;
+			const auto last = static_cast<uint32_t>(entries.size()) - 1;
+
+			slots[slotIndex].index = tombstone;
+			++tombstones;
+
+			if (index != last)
+			{
+				// Point the last entry's slot at the gap it's moving into
+				auto i = FindSlot(entries[last].first, hashes[last]);
+				slots[i].index = index;
+
+				entries[index] = std::move(entries[last]);
+				hashes[index] = hashes[last];
+			}
+
+			entries.pop_back();
+			hashes.pop_back();
+		}
+
+	public:
+		auto begin() { return entries.begin(); }
+		auto begin() const { return entries.begin(); }
+		auto end() { return entries.end(); }
+		auto end() const { return entries.end(); }
+
+		size_t Size() const { return entries.size(); }
+		bool Empty() const { return entries.empty(); }
+
+		void Reserve(size_t count)
+		{
+			entries.reserve(count);
+			hashes.reserve(count);
+
+			uint32_t capacity = minCapacity;
+			while (capacity * 7 < count * 8) capacity <<= 1;
+			if (capacity > slots.size()) Rehash(capacity);
+		}
+
+		V* Find(const K& key)
+		{
+			const auto i = FindSlot(key, Mix(Hash{}(key)));
+			return i == empty ? nullptr : &entries[slots[i].index].second;
+		}
+
+		bool Contains(const K& key) const { return FindSlot(key, Mix(Hash{}(key))) != empty; }
+
+		// Returns the value for key and whether it was inserted, new values are default constructed
+		std::pair<V*, bool> TryEmplace(const K& key)
+		{
+			// Keep at most 7/8ths of the slots used, counting tombstones as they lengthen probes just the same
+			if ((entries.size() + tombstones + 1) * 8 > slots.size() * 7)
+			{
+				auto capacity = std::max(minCapacity, static_cast<uint32_t>(slots.size()));
+				if ((entries.size() + 1) * 2 > capacity) capacity <<= 1;
+				Rehash(capacity);
+			}
+
+			const auto hash = Mix(Hash{}(key));
+			uint32_t insertAt = empty;
+
+			for (uint32_t i = static_cast<uint32_t>(hash) & Mask();; i = (i + 1) & Mask())
+			{
+				auto& slot = slots[i];
+
+				if (slot.index == tombstone)
+				{
+					if (insertAt == empty) insertAt = i;
+					continue;
+				}
+
+				if (slot.index == empty)
+				{
+					if (insertAt == empty) insertAt = i;
+					else --tombstones;
+					break;
+				}
+
+				if (slot.hash == hash && entries[slot.index].first == key) return { &entries[slot.index].second, false };
+			}
+
+			slots[insertAt] = { hash, static_cast<uint32_t>(entries.size()) };
+			entries.emplace_back(key, V{});
+			hashes.push_back(hash);
+
+			return { &entries.back().second, true };
+		}
+
+		V& operator[](const K& key) { return *TryEmplace(key).first; }
+
+		bool Erase(const K& key)
+		{
+			const auto i = FindSlot(key, Mix(Hash{}(key)));
+			if (i == empty) return false;
+
+			EraseSlot(i);
+			return true;
+		}
+
+		// predicate(const K&, V&), returns the number of entries erased
+		template <class Predicate>
+		uint32_t EraseIf(Predicate predicate)
+		{
+			uint32_t count = 0;
+
+			// Backwards, so whatever gets moved into a gap has already been visited
+			for (auto index = static_cast<uint32_t>(entries.size()); index-- > 0;)
+			{
+				if (!predicate(entries[index].first, entries[index].second)) continue;
+
+				EraseSlot(FindSlot(entries[index].first, hashes[index]));
+				++count;
+			}
+
+			return count;
+		}
+
+		void Clear()
+		{
+			slots.clear();
+			entries.clear();
+			hashes.clear();
+			tombstones = 0;
+		}
+	};
+}
@@ -1,53 +1,119 @@
 #include "Framebuffer.h"
 #include "Renderpass.h"
+#include "../Memory/Allocator.h"
+#include "../Memory/Image.h"
+#include "../../Utils/Logging.h"
+#include <algorithm>
 
 namespace Renderer
 {
-	FramebufferKey::FramebufferKey(std::vector<VkImageView> imageViews, Renderpass* renderpass, VkExtent2D extent) : imageViews(std::move(imageViews)), renderpass(renderpass), extent(extent) { }
+	FramebufferKey::FramebufferKey(const VkImageView* imageViews, uint32_t count, Renderpass* renderpass, VkExtent2D extent) : attachmentCount(count), renderpass(renderpass), extent(extent)
+	{
+		Assert(count <= maxAttachments, "Too many attachments for a framebuffer key");
+		std::copy_n(imageViews, count, this->imageViews);
+	}
 
+	FramebufferKey::FramebufferKey(const FramebufferAttachment* attachments, uint32_t count, Renderpass* renderpass, VkExtent2D extent) : attachmentCount(count), imageless(true), renderpass(renderpass), extent(extent)
+	{
+		Assert(count <= maxAttachments, "Too many attachments for a framebuffer key");
+		std::copy_n(attachments, count, this->attachments);
+	}
 
-	bool FramebufferKey::operator==(const FramebufferKey& other) const { return std::tie(imageViews, extent.width, extent.height) == std::tie(other.imageViews, other.extent.width, other.extent.height); }
+	bool FramebufferAttachment::operator==(const FramebufferAttachment& other) const
+	{
+		return std::tie(format, usage, extent.width, extent.height) == std::tie(other.format, other.usage, other.extent.width, other.extent.height);
+	}
 
-	FramebufferBundle::FramebufferBundle(VkDevice* device, FramebufferKey key, uint32_t count) : device(device)
+	bool FramebufferKey::operator==(const FramebufferKey& other) const
 	{
-		framebuffers.resize(count);
+		if (std::tie(attachmentCount, imageless, extent.width, extent.height) != std::tie(other.attachmentCount, other.imageless, other.extent.width, other.extent.height)) return false;
+
+		if (imageless) return std::equal(attachments, attachments + attachmentCount, other.attachments);
+		return std::equal(imageViews, imageViews + attachmentCount, other.imageViews);
+	}
 
-		for (uint32_t i = 0; i < count; i++)
+	FramebufferBundle::FramebufferBundle(VkDevice* device, const FramebufferKey& key) : device(device)
+	{
+		VkFramebufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+		createInfo.attachmentCount = key.attachmentCount;
+		createInfo.pAttachments = key.imageViews;
+		createInfo.width = key.extent.width;
+		createInfo.height = key.extent.height;
+		createInfo.renderPass = key.renderpass->GetHandle();
+		createInfo.layers = 1;
+
+		// Has to outlive vkCreateFramebuffer, the image infos point into it
+		auto attachmentImageInfos = std::vector<VkFramebufferAttachmentImageInfo>();
+		VkFramebufferAttachmentsCreateInfo attachmentsInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO };
+
+		if (key.IsImageless())
 		{
-			VkFramebufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-			createInfo.attachmentCount = static_cast<uint32_t>(key.imageViews.size());
-			createInfo.pAttachments = key.imageViews.data();
-			createInfo.width = key.extent.width;
-			createInfo.height = key.extent.height;
-			createInfo.renderPass = key.renderpass->GetHandle();
-			createInfo.layers = 1;
-
-			vkCreateFramebuffer(*device, &createInfo, nullptr, &framebuffers[i]);
+			for (uint32_t i = 0; i < key.attachmentCount; i++)
+			{
+				const auto& attachment = key.attachments[i];
+
+				VkFramebufferAttachmentImageInfo imageInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO };
+				imageInfo.usage = attachment.usage;
+				imageInfo.width = attachment.extent.width;
+				imageInfo.height = attachment.extent.height;
+				imageInfo.layerCount = 1;
+				imageInfo.viewFormatCount = 1;
+				imageInfo.pViewFormats = &attachment.format;
+
+				attachmentImageInfos.push_back(imageInfo);
+			}
+
+			attachmentsInfo.attachmentImageInfoCount = static_cast<uint32_t>(attachmentImageInfos.size());
+			attachmentsInfo.pAttachmentImageInfos = attachmentImageInfos.data();
+
+			createInfo.pNext = &attachmentsInfo;
+			createInfo.flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT;
+			createInfo.attachmentCount = attachmentsInfo.attachmentImageInfoCount;
 		}
+
+		vkCreateFramebuffer(*device, &createInfo, nullptr, &framebuffer);
 	}
 
-	void FramebufferCache::BuildCache(VkDevice* device, uint32_t framesInFlight)
+	void FramebufferCache::BuildCache(VkDevice* device, bool imageless)
 	{
 		this->device = device;
-		this->framesInFlight = framesInFlight;
+		this->imageless = imageless;
 	}
 
-	void FramebufferCache::BeginPass(VkCommandBuffer buffer, uint32_t index, const std::vector<VkImageView>& views, Renderpass* renderpass, VkExtent2D extent)
+	void FramebufferCache::BeginPass(VkCommandBuffer buffer, const std::vector<Memory::Image*>& attachments, Renderpass* renderpass, VkExtent2D extent)
 	{
-		FramebufferKey key = FramebufferKey(views, renderpass, extent);
+		Assert(attachments.size() <= FramebufferKey::maxAttachments, "Too many attachments for a framebuffer");
 
-		auto framebuffer = Get(key);
+		// Runs for every pass every frame, so everything stays on the stack
+		const auto count = static_cast<uint32_t>(attachments.size());
+		VkImageView views[FramebufferKey::maxAttachments];
+		for (uint32_t i = 0; i < count; i++) views[i] = attachments[i]->GetView();
+
+		FramebufferBundle* framebuffer;
+		if (imageless)
+		{
+			FramebufferAttachment configuration[FramebufferKey::maxAttachments];
+			for (uint32_t i = 0; i < count; i++) configuration[i] = { attachments[i]->GetFormat(), attachments[i]->GetUsage(), attachments[i]->GetExtent() };
+
+			framebuffer = Get(FramebufferKey(configuration, count, renderpass, extent));
+		}
+		else framebuffer = Get(FramebufferKey(views, count, renderpass, extent));
+
+		VkRenderPassAttachmentBeginInfo attachmentInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO };
+		attachmentInfo.attachmentCount = count;
+		attachmentInfo.pAttachments = views;
 
 		VkRenderPassBeginInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.pNext = imageless ? &attachmentInfo : nullptr;
 		renderPassInfo.renderPass = renderpass->GetHandle();
-		renderPassInfo.framebuffer = framebuffer->GetHandle().at(index);
+		renderPassInfo.framebuffer = framebuffer->GetHandle();
 		renderPassInfo.renderArea.offset = { 0, 0 };
 		renderPassInfo.renderArea.extent = extent;
 
-		std::vector<VkClearValue> clearColors = { { 0.2f, 0.2f, 0.2f, 1.0f }, { 1.0f, 0 } };
+		const VkClearValue clearColors[] = { { 0.2f, 0.2f, 0.2f, 1.0f }, { 1.0f, 0 } };
 		renderPassInfo.clearValueCount = 2;
-		renderPassInfo.pClearValues = clearColors.data();
+		renderPassInfo.pClearValues = clearColors;
 
 		VkViewport viewport = {};
 		viewport.width = static_cast<float>(extent.width);
@@ -69,19 +135,33 @@ namespace Renderer
 
 	FramebufferBundle* FramebufferCache::Get(const FramebufferKey& key)
 	{
-		auto& framebuffer = cache[key];
-		if (!framebuffer) { framebuffer = new FramebufferBundle(device, key, framesInFlight); }
-		return framebuffer;
+		return FindOrEmplace(key, device, key);
 	}
 
 	bool FramebufferCache::Add(const FramebufferKey& key)
 	{
-		if (cache.find(key) != cache.end()) return false;
+		if (cache.Contains(key)) return false;
 
-		cache.emplace(key, new FramebufferBundle(device, key, framesInFlight));
+		Emplace(key, device, key);
 
 		return true;
 	}
 
-	void FramebufferCache::ClearEntry(FramebufferBundle* framebuffers) { for (auto framebuffer : framebuffers->GetHandle()) { vkDestroyFramebuffer(*device, framebuffer, nullptr); } }
+	void FramebufferCache::Retire(const std::vector<VkImageView>& views, const std::vector<VkExtent2D>& extents, Memory::Allocator* allocator)
+	{
+		if (views.empty() && extents.empty()) return;
+
+		Cache::Retire([&](const FramebufferKey& key)
+		{
+			if (key.IsImageless())
+			{
+				return std::any_of(extents.begin(), extents.end(), [&](VkExtent2D extent) { return extent.width == key.extent.width && extent.height == key.extent.height; });
+			}
+
+			return std::any_of(key.imageViews, key.imageViews + key.attachmentCount, [&](VkImageView view) { return std::find(views.begin(), views.end(), view) != views.end(); });
+		},
+		[allocator](auto cleanup) { allocator->Defer([cleanup](VkDevice) { cleanup(); }); });
+	}
+
+	void FramebufferCache::ClearEntry(FramebufferBundle* framebuffer) { vkDestroyFramebuffer(*device, framebuffer->GetHandle(), nullptr); }
 }
@@ -6,27 +6,55 @@
 namespace Renderer
 {
 	struct Renderpass;
+	namespace Memory
+	{
+		class Allocator;
+		class Image;
+	}
+
+	// What an image has to look like to be used as an attachment of an imageless framebuffer
+	struct FramebufferAttachment
+	{
+		VkFormat format;
+		VkImageUsageFlags usage;
+		VkExtent2D extent;
+
+		bool operator ==(const FramebufferAttachment& other) const;
+	};
 
+	// Keyed on the views themselves, or with imageless framebuffers only on what the views look like.
+	// The renderpass isn't part of it, any compatible one can use the framebuffer.
+	// Held inline so a lookup each pass doesn't touch the heap
 	struct FramebufferKey
 	{
-		FramebufferKey(std::vector<VkImageView> imageViews, Renderpass* renderpass, VkExtent2D extent);
+		static constexpr uint32_t maxAttachments = 8;
 
-		std::vector<VkImageView> imageViews;
+		FramebufferKey(const VkImageView* imageViews, uint32_t count, Renderpass* renderpass, VkExtent2D extent);
+		FramebufferKey(const FramebufferAttachment* attachments, uint32_t count, Renderpass* renderpass, VkExtent2D extent);
+
+		// Only the one matching imageless is filled in
+		VkImageView imageViews[maxAttachments] = {};
+		FramebufferAttachment attachments[maxAttachments] = {};
+		uint32_t attachmentCount = 0;
+		bool imageless = false;
 		Renderpass* renderpass;
 		VkExtent2D extent;
 
+		bool IsImageless() const { return imageless; }
+
 		bool operator ==(const FramebufferKey& other) const;
 	};
 
+	// Views don't change between frames in flight, so one framebuffer is shared by all of them
 	struct FramebufferBundle
 	{
-		FramebufferBundle(VkDevice* device, FramebufferKey key, uint32_t count);
+		FramebufferBundle(VkDevice* device, const FramebufferKey& key);
 
-		std::vector<VkFramebuffer> GetHandle() { return framebuffers; }
+		VkFramebuffer GetHandle() { return framebuffer; }
 
 	private:
 		VkDevice* device;
-		std::vector<VkFramebuffer> framebuffers;
+		VkFramebuffer framebuffer;
 	};
 }
 
@@ -40,8 +68,21 @@ namespace std
 			size_t h1 = hash<uint32_t>{}(s.extent.width);
 			h1 = h1 ^ (hash<uint32_t>{}(s.extent.height) << 1);
 
-			h1 ^= (s.imageViews.size() << 1);
-			for (auto& i : s.imageViews) h1 ^= reinterpret_cast<uint64_t>(i) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+			h1 ^= (s.attachmentCount << (s.imageless ? 2 : 1));
+			for (uint32_t i = 0; i < s.attachmentCount; i++)
+			{
+				if (!s.imageless)
+				{
+					h1 ^= reinterpret_cast<uint64_t>(s.imageViews[i]) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+					continue;
+				}
+
+				const auto& attachment = s.attachments[i];
+				size_t h2 = hash<underlying_type<VkFormat>::type>{}(attachment.format) ^ (hash<uint32_t>{}(attachment.usage) << 1);
+				h2 ^= hash<uint32_t>{}(attachment.extent.width) ^ (hash<uint32_t>{}(attachment.extent.height) << 1);
+
+				h1 ^= h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+			}
 
 			return h1;
 		}
@@ -53,19 +94,25 @@ namespace Renderer
 	class FramebufferCache : public Cache<FramebufferBundle, FramebufferKey>
 	{
 	public:
-		void BuildCache(VkDevice* device, uint32_t framesInFlight);
+		// With imageless set (VK_KHR_imageless_framebuffer, core in 1.2) there's one framebuffer per attachment configuration
+		// and the views are handed over in BeginPass, otherwise one per set of views
+		void BuildCache(VkDevice* device, bool imageless);
 
-		void BeginPass(VkCommandBuffer buffer, uint32_t index, const std::vector<VkImageView>& views, Renderpass* renderpass, VkExtent2D extent);
+		void BeginPass(VkCommandBuffer buffer, const std::vector<Memory::Image*>& attachments, Renderpass* renderpass, VkExtent2D extent);
 		void EndPass(VkCommandBuffer buffer);
 
 		FramebufferBundle* Get(const FramebufferKey& key) override;
 		bool Add(const FramebufferKey& key) override;
 
+		// Drops every framebuffer using one of views, and every imageless one the size of one of extents, since those have no
+		// views to go by. They're destroyed once the frames using them are done, imageless ones still needed are simply rebuilt
+		void Retire(const std::vector<VkImageView>& views, const std::vector<VkExtent2D>& extents, Memory::Allocator* allocator);
+
 	private:
 
-		void ClearEntry(FramebufferBundle* framebuffers) override;
+		void ClearEntry(FramebufferBundle* framebuffer) override;
 
 		VkDevice* device;
-		uint32_t framesInFlight;
+		bool imageless = false;
 	};
 }
@@ -0,0 +1,132 @@
+#include "LayoutCache.h"
+#include "../../Utils/Logging.h"
+#include <algorithm>
+#include <tuple>
+
+namespace Renderer
+{
+	DescriptorSetLayout::DescriptorSetLayout(VkDevice* device, const VkDescriptorSetLayoutCreateInfo& layoutInfo) : device(device)
+	{
+		auto success = vkCreateDescriptorSetLayout(*device, &layoutInfo, nullptr, &layout);
+		Assert(success == VK_SUCCESS, "Failed to create descriptor set layout");
+	}
+
+	DescriptorSetLayout::~DescriptorSetLayout() { vkDestroyDescriptorSetLayout(*device, layout, nullptr); }
+
+	bool DescriptorSetLayoutKey::operator==(const DescriptorSetLayoutKey& other) const
+	{
+		if (flags != other.flags || bindings.size() != other.bindings.size() || bindingFlags != other.bindingFlags) return false;
+
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			const auto& a = bindings[i];
+			const auto& b = other.bindings[i];
+			if (std::tie(a.binding, a.descriptorType, a.descriptorCount, a.stageFlags) != std::tie(b.binding, b.descriptorType, b.descriptorCount, b.stageFlags)) return false;
+		}
+
+		return true;
+	}
+
+	PipelineLayout::PipelineLayout(VkDevice* device, const std::vector<DescriptorSetLayout*>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+		: device(device), setLayouts(setLayouts), pushConstants(pushConstants)
+	{
+		std::vector<VkDescriptorSetLayout> layouts;
+		for (auto* setLayout : setLayouts) layouts.push_back(setLayout->GetLayout());
+
+		VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+		layoutInfo.pSetLayouts = layouts.data();
+		layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+		layoutInfo.pPushConstantRanges = pushConstants.data();
+
+		auto success = vkCreatePipelineLayout(*device, &layoutInfo, nullptr, &layout);
+		Assert(success == VK_SUCCESS, "Failed to create pipeline layout");
+	}
+
+	PipelineLayout::~PipelineLayout() { vkDestroyPipelineLayout(*device, layout, nullptr); }
+
+	static bool SameRanges(const std::vector<VkPushConstantRange>& a, const std::vector<VkPushConstantRange>& b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) { return std::tie(x.stageFlags, x.offset, x.size) == std::tie(y.stageFlags, y.offset, y.size); });
+	}
+
+	bool PipelineLayout::IsCompatible(const PipelineLayout* other, uint32_t set) const
+	{
+		if (other == this) return set < setLayouts.size();
+		if (set >= setLayouts.size() || set >= other->setLayouts.size() || !SameRanges(pushConstants, other->pushConstants)) return false;
+
+		return std::equal(setLayouts.begin(), setLayouts.begin() + set + 1, other->setLayouts.begin());
+	}
+
+	bool PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const { return setLayouts == other.setLayouts && SameRanges(pushConstants, other.pushConstants); }
+
+	void DescriptorSetLayoutCache::BuildCache(VkDevice* device) { this->device = device; }
+
+	DescriptorSetLayout* DescriptorSetLayoutCache::Get(const DescriptorSetLayoutKey& key)
+	{
+		return TryCreate(key, [&]
+		{
+			Assert(key.bindingFlags.empty() || key.bindingFlags.size() == key.bindings.size(), "Binding flags don't match the bindings");
+
+			VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+			bindingFlagsInfo.bindingCount = static_cast<uint32_t>(key.bindingFlags.size());
+			bindingFlagsInfo.pBindingFlags = key.bindingFlags.data();
+
+			VkDescriptorSetLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+			layoutInfo.pNext = key.bindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+			layoutInfo.flags = key.flags;
+			layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+			layoutInfo.pBindings = key.bindings.data();
+
+			return arena.Create(device, layoutInfo);
+		}).first;
+	}
+
+	bool DescriptorSetLayoutCache::Add(const DescriptorSetLayoutKey& key)
+	{
+		if (cache.Contains(key)) return false;
+
+		Get(key);
+
+		return true;
+	}
+
+	// Destroying the layout is all there is to it
+	void DescriptorSetLayoutCache::ClearEntry(DescriptorSetLayout* layout) { }
+
+	void PipelineLayoutCache::BuildCache(VkDevice* device, DescriptorSetLayoutCache* setLayouts, uint32_t maxBoundSets)
+	{
+		this->device = device;
+		this->setLayouts = setLayouts;
+		this->maxBoundSets = maxBoundSets;
+	}
+
+	PipelineLayout* PipelineLayoutCache::Create(const PipelineLayoutKey& key)
+	{
+		// With the bindless heap at set 0 a program's Draw set lands at set 4, past what some devices bind
+		Assert(key.setLayouts.size() <= maxBoundSets, "Pipeline layout has more sets than maxBoundDescriptorSets");
+
+		for (auto* setLayout : key.setLayouts) setLayouts->AddReference(setLayout);
+
+		return arena.Create(device, key.setLayouts, key.pushConstants);
+	}
+
+	PipelineLayout* PipelineLayoutCache::Get(const PipelineLayoutKey& key)
+	{
+		return TryCreate(key, [&] { return Create(key); }).first;
+	}
+
+	bool PipelineLayoutCache::Add(const PipelineLayoutKey& key)
+	{
+		if (cache.Contains(key)) return false;
+
+		Get(key);
+
+		return true;
+	}
+
+	void PipelineLayoutCache::ClearEntry(PipelineLayout* layout)
+	{
+		for (auto* setLayout : layout->setLayouts) setLayouts->Release(setLayout);
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <vector>
+#include <vulkan_core.h>
+#include "Cache.h"
+
+namespace Renderer
+{
+	// A descriptor set layout shared by everyone asking for the same bindings, so pipeline layouts built from it come out
+	// compatible and sets bound with one stay bound under the other
+	class DescriptorSetLayout : public RefCounted
+	{
+	private:
+		VkDescriptorSetLayout layout;
+		VkDevice* device;
+	public:
+		DescriptorSetLayout(const DescriptorSetLayout&) = delete;
+		DescriptorSetLayout& operator=(const DescriptorSetLayout&) = delete;
+
+		DescriptorSetLayout(VkDevice* device, const VkDescriptorSetLayoutCreateInfo& layoutInfo);
+		~DescriptorSetLayout();
+
+		VkDescriptorSetLayout GetLayout() const { return layout; }
+	};
+
+	struct DescriptorSetLayoutKey
+	{
+		VkDescriptorSetLayoutCreateFlags flags = 0;
+
+		// Sorted by binding, immutable samplers aren't supported. bindingFlags is empty or runs parallel
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		std::vector<VkDescriptorBindingFlags> bindingFlags;
+
+		bool operator ==(const DescriptorSetLayoutKey& other) const;
+	};
+
+	class PipelineLayout : public RefCounted
+	{
+		friend class PipelineLayoutCache;
+	private:
+		VkPipelineLayout layout;
+		VkDevice* device;
+
+		// Each one referenced for as long as the pipeline layout lives, its handle can't be reused while the key still names it
+		std::vector<DescriptorSetLayout*> setLayouts;
+		std::vector<VkPushConstantRange> pushConstants;
+	public:
+		PipelineLayout(const PipelineLayout&) = delete;
+		PipelineLayout& operator=(const PipelineLayout&) = delete;
+
+		PipelineLayout(VkDevice* device, const std::vector<DescriptorSetLayout*>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+		~PipelineLayout();
+
+		VkPipelineLayout GetLayout() const { return layout; }
+		uint32_t GetSetCount() const { return static_cast<uint32_t>(setLayouts.size()); }
+
+		// Whether a set bound at set with either layout can be used with the other, the sets up to it and the push
+		// constant ranges have to match
+		bool IsCompatible(const PipelineLayout* other, uint32_t set) const;
+	};
+
+	struct PipelineLayoutKey
+	{
+		// Layouts are interned, so the pointers say everything about them
+		std::vector<DescriptorSetLayout*> setLayouts;
+		std::vector<VkPushConstantRange> pushConstants;
+
+		bool operator ==(const PipelineLayoutKey& other) const;
+	};
+}
+
+namespace std
+{
+	template <>
+	struct hash<Renderer::DescriptorSetLayoutKey>
+	{
+		size_t operator()(const Renderer::DescriptorSetLayoutKey& s) const noexcept
+		{
+			size_t h1 = hash<uint32_t>{}(s.flags);
+			for (const auto& binding : s.bindings)
+			{
+				const uint32_t fields[] = { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags };
+				for (auto field : fields) h1 ^= hash<uint32_t>{}(field) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+			}
+			for (auto flags : s.bindingFlags) h1 ^= hash<uint32_t>{}(flags) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+
+			return h1;
+		}
+	};
+
+	template <>
+	struct hash<Renderer::PipelineLayoutKey>
+	{
+		size_t operator()(const Renderer::PipelineLayoutKey& s) const noexcept
+		{
+			size_t h1 = s.setLayouts.size();
+			for (auto* layout : s.setLayouts) h1 ^= hash<uint64_t>{}(reinterpret_cast<uint64_t>(layout)) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+			for (const auto& range : s.pushConstants)
+			{
+				const uint32_t fields[] = { range.stageFlags, range.offset, range.size };
+				for (auto field : fields) h1 ^= hash<uint32_t>{}(field) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+			}
+
+			return h1;
+		}
+	};
+}
+
+namespace Renderer
+{
+	// Every descriptor set layout, handed out by binding list
+	class DescriptorSetLayoutCache : public RefCountedCache<DescriptorSetLayout, DescriptorSetLayoutKey>
+	{
+	public:
+		void BuildCache(VkDevice* device);
+
+		DescriptorSetLayout* Get(const DescriptorSetLayoutKey& key) override;
+		bool Add(const DescriptorSetLayoutKey& key) override;
+
+	private:
+		VkDevice* device;
+
+		void ClearEntry(DescriptorSetLayout* layout) override;
+	};
+
+	// Every pipeline layout, handed out by set layouts and push constant ranges. Programs with the same interface share
+	// one, which is what lets DescriptorSetCache leave sets bound across a pipeline change
+	class PipelineLayoutCache : public RefCountedCache<PipelineLayout, PipelineLayoutKey>
+	{
+	public:
+		// The set layouts of every pipeline layout come from setLayouts, clear this one first. maxBoundSets is the device's
+		// maxBoundDescriptorSets, which may be as low as 4
+		void BuildCache(VkDevice* device, DescriptorSetLayoutCache* setLayouts, uint32_t maxBoundSets);
+
+		DescriptorSetLayoutCache* GetSetLayouts() { return setLayouts; }
+
+		PipelineLayout* Get(const PipelineLayoutKey& key) override;
+		bool Add(const PipelineLayoutKey& key) override;
+
+	private:
+		VkDevice* device;
+		DescriptorSetLayoutCache* setLayouts;
+		uint32_t maxBoundSets;
+
+		PipelineLayout* Create(const PipelineLayoutKey& key);
+
+		void ClearEntry(PipelineLayout* layout) override;
+	};
+}
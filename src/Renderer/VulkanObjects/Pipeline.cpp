@@ -1,5 +1,13 @@
 #include "Pipeline.h"
 #include "../Resources/ShaderProgram.h"
+#include "Device.h"
+#include "PipelineCompiler.h"
+#include "PipelineManifest.h"
+#include "../RenderGraph/GraphContext.h"
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <type_traits>
 
 namespace Renderer
 {
@@ -81,28 +89,122 @@ namespace Renderer
 			       other.blendState.colorBlendOp, other.blendState.srcColorBlendFactor, other.blendState.dstColorBlendFactor);
 	}
 
-	bool GraphicsPipelineKey::operator==(const GraphicsPipelineKey& other) const
+	// Hashing and comparing as raw bytes relies on there being no padding for garbage to end up in
+	static_assert(std::is_trivially_copyable_v<GraphicsPipelineKey>);
+	static_assert(sizeof(PackedBlend) == sizeof(uint32_t));
+	static_assert(offsetof(GraphicsPipelineKey, hash) == sizeof(VkRenderPass) + 2 * sizeof(uint16_t) + 12 * sizeof(uint8_t) +
+	              GraphicsPipelineKey::maxColourAttachments * (sizeof(VkFormat) + sizeof(PackedBlend)));
+
+	PackedBlend PackedBlend::Pack(const BlendSettings& settings)
+	{
+		const auto& state = settings.blendState;
+		Assert(state.colorBlendOp <= VK_BLEND_OP_MAX && state.alphaBlendOp <= VK_BLEND_OP_MAX, "Only the core blend ops can be packed");
+
+		PackedBlend packed = {};
+		packed.enable = state.blendEnable ? 1 : 0;
+		packed.colourOp = state.colorBlendOp;
+		packed.alphaOp = state.alphaBlendOp;
+		packed.srcColour = state.srcColorBlendFactor;
+		packed.dstColour = state.dstColorBlendFactor;
+		packed.srcAlpha = state.srcAlphaBlendFactor;
+		packed.dstAlpha = state.dstAlphaBlendFactor;
+		packed.writeMask = state.colorWriteMask;
+
+		return packed;
+	}
+
+	VkPipelineColorBlendAttachmentState PackedBlend::Unpack() const
+	{
+		VkPipelineColorBlendAttachmentState state = {};
+		state.blendEnable = enable;
+		state.colorBlendOp = static_cast<VkBlendOp>(colourOp);
+		state.alphaBlendOp = static_cast<VkBlendOp>(alphaOp);
+		state.srcColorBlendFactor = static_cast<VkBlendFactor>(srcColour);
+		state.dstColorBlendFactor = static_cast<VkBlendFactor>(dstColour);
+		state.srcAlphaBlendFactor = static_cast<VkBlendFactor>(srcAlpha);
+		state.dstAlphaBlendFactor = static_cast<VkBlendFactor>(dstAlpha);
+		state.colorWriteMask = writeMask;
+
+		return state;
+	}
+
+	// Dynamic topology has to stay within the class the pipeline was built with
+	static VkPrimitiveTopology GetTopologyClass(VkPrimitiveTopology topology)
+	{
+		switch (topology)
+		{
+			case VK_PRIMITIVE_TOPOLOGY_POINT_LIST: return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+			case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+			case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+			case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+			case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY: return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+			case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST: return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+			default: return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		}
+	}
+
+	GraphicsPipelineKey::GraphicsPipelineKey(VkRenderPass renderpass, uint16_t program, uint16_t vertexLayout, const DepthSettings& depthSettings, const BlendSettings* blendSettings, uint32_t blendCount,
+	                                         VkPrimitiveTopology topology, bool extendedDynamicState, const VkFormat* colourFormats)
+		: renderpass(renderpass), program(program), vertexLayout(vertexLayout), attachmentCount(static_cast<uint8_t>(blendCount)), extendedDynamicState(extendedDynamicState ? 1 : 0)
 	{
-		if (program->getIds() != other.program->getIds()) return false;
-		if (topology != other.topology) return false;
+		Assert(blendCount <= maxColourAttachments, "Too many colour attachments for a pipeline key");
+		Assert((renderpass != VK_NULL_HANDLE) != (colourFormats != nullptr), "A pipeline key needs either a renderpass or its attachment formats");
 
-		return std::tie(vertexAttributes, depthSetting, blendSettings, renderpass, extent.width, extent.height) == std::tie(other.vertexAttributes, other.depthSetting, other.blendSettings, other.renderpass, other.extent.width,
-			       other.extent.height);
+		for (uint32_t i = 0; i < blendCount; i++) blend[i] = PackedBlend::Pack(blendSettings[i]);
+		if (colourFormats) std::copy_n(colourFormats, blendCount, this->colourFormats);
+
+		state.topology = static_cast<uint8_t>(topology);
+		state.depthFunc = static_cast<uint8_t>(depthSettings.depthFunc);
+		state.depthWrite = depthSettings.writeEnable ? 1 : 0;
+
+		if (extendedDynamicState) this->topology = static_cast<uint8_t>(GetTopologyClass(topology));
+		else
+		{
+			this->topology = state.topology;
+			depthFunc = state.depthFunc;
+			depthWrite = state.depthWrite;
+		}
+
+		// FNV-1a over everything before the hash
+		auto* bytes = reinterpret_cast<const uint8_t*>(this);
+		hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < offsetof(GraphicsPipelineKey, hash); i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
 	}
 
-	Pipeline::Pipeline(VkDevice* device, GraphicsPipelineKey key)
+	bool GraphicsPipelineKey::operator==(const GraphicsPipelineKey& other) const
 	{
-		Assert(!(device == nullptr || key.renderpass == nullptr || key.extent.width == 0 || key.extent.height == 0), "Failed to obtain required information to create the graphics pipeline");
+		return hash == other.hash && std::memcmp(this, &other, offsetof(GraphicsPipelineKey, hash)) == 0;
+	}
 
+	Pipeline::Pipeline(VkDevice* device, VkPipelineCache pipelineCache, const GraphicsPipelineKey& key, ShaderProgram* program, VertexAttributes vertexAttributes) : Pipeline(device, program)
+	{
+		Compile(pipelineCache, key, std::move(vertexAttributes));
+	}
+
+	Pipeline::Pipeline(VkDevice* device, ShaderProgram* program)
+	{
 		this->device = device;
-		key.program->InitialiseResources(device);
-		this->program = key.program;
-		this->descriptorSetLayout = key.program->getDescriptorLayout();
-		this->pipelineLayout = key.program->getPipelineLayout();
+		program->InitialiseResources(device);
+		this->program = program;
+		this->descriptorSetLayout = program->getDescriptorLayout();
+		this->pipelineLayout = program->getPipelineLayout();
+	}
+
+	Pipeline::~Pipeline()
+	{
+		// Every pipeline gets compiled eventually, and the compiler drains its queue before stopping
+		while (!IsReady()) std::this_thread::yield();
+
+		if (pipeline != VK_NULL_HANDLE) vkDestroyPipeline(*device, pipeline, nullptr);
+	}
+
+	void Pipeline::Compile(VkPipelineCache pipelineCache, const GraphicsPipelineKey& key, VertexAttributes vertexAttributes)
+	{
+		Assert(!(device == nullptr || (key.renderpass == nullptr && key.attachmentCount == 0)), "Failed to obtain required information to create the graphics pipeline");
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaderCreateInfo = {};
 
-		for (const auto& shader : key.program->getShaders())
+		for (const auto& shader : program->getShaders())
 		{
 			switch (shader->getType())
 			{
@@ -115,8 +217,8 @@ namespace Renderer
 			}
 		}
 
-		auto bindingDescription = key.vertexAttributes.getBindings();
-		auto attributeDescription = key.vertexAttributes.getAttributes();
+		auto bindingDescription = vertexAttributes.getBindings();
+		auto attributeDescription = vertexAttributes.getAttributes();
 
 		VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
 		vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -127,27 +229,14 @@ namespace Renderer
 
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
 		inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssemblyCreateInfo.topology = key.topology;
+		inputAssemblyCreateInfo.topology = static_cast<VkPrimitiveTopology>(key.topology);
 		inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(key.extent.width);
-		viewport.height = static_cast<float>(key.extent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0, 0 };
-		scissor.extent = key.extent;
-
+		// Both dynamic, set by FramebufferCache::BeginPass
 		VkPipelineViewportStateCreateInfo viewportCreateInfo = {};
 		viewportCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportCreateInfo.viewportCount = 1;
-		viewportCreateInfo.pViewports = &viewport;
 		viewportCreateInfo.scissorCount = 1;
-		viewportCreateInfo.pScissors = &scissor;
 
 		VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
 		rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -168,9 +257,9 @@ namespace Renderer
 		colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 		colorBlendCreateInfo.logicOpEnable = VK_FALSE;
 		colorBlendCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-		colorBlendCreateInfo.attachmentCount = static_cast<uint32_t>(key.blendSettings.size());
-		auto& colourAttachments = std::vector<VkPipelineColorBlendAttachmentState>();
-		for (auto& blendSetting : key.blendSettings) { colourAttachments.push_back(blendSetting.blendState); }
+		colorBlendCreateInfo.attachmentCount = key.attachmentCount;
+		auto colourAttachments = std::vector<VkPipelineColorBlendAttachmentState>();
+		for (uint32_t i = 0; i < key.attachmentCount; i++) { colourAttachments.push_back(key.blend[i].Unpack()); }
 		colorBlendCreateInfo.pAttachments = colourAttachments.data();
 		colorBlendCreateInfo.blendConstants[0] = 0.0f;
 		colorBlendCreateInfo.blendConstants[1] = 0.0f;
@@ -180,16 +269,23 @@ namespace Renderer
 		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
 		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = key.depthSetting.writeEnable;
-		depthStencil.depthCompareOp = key.depthSetting.depthFunc;
+		depthStencil.depthWriteEnable = key.depthWrite;
+		depthStencil.depthCompareOp = static_cast<VkCompareOp>(key.depthFunc);
 		depthStencil.depthBoundsTestEnable = VK_FALSE;
 		depthStencil.stencilTestEnable = VK_FALSE;
 
 		auto dynamicStates = std::vector<VkDynamicState>{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
+		// The values above are ignored, GraphicsPipelineCache::BindGraphicsPipeline sets them from the key
+		if (key.extendedDynamicState)
+		{
+			dynamicStates.insert(dynamicStates.end(), { VK_DYNAMIC_STATE_CULL_MODE_EXT, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+			                                            VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT });
+		}
+
 		VkPipelineDynamicStateCreateInfo dynamicState = {};
 		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.dynamicStateCount = 2;
+		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
 		dynamicState.pDynamicStates = dynamicStates.data();
 
 		VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {};
@@ -207,14 +303,23 @@ namespace Renderer
 		graphicsPipelineCreateInfo.layout = pipelineLayout;
 		graphicsPipelineCreateInfo.renderPass = key.renderpass;
 
+		// Dynamic rendering, the attachment formats stand in for the renderpass
+		VkPipelineRenderingCreateInfoKHR renderingCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR };
+		renderingCreateInfo.colorAttachmentCount = key.attachmentCount;
+		renderingCreateInfo.pColorAttachmentFormats = key.colourFormats;
+		if (key.renderpass == VK_NULL_HANDLE) graphicsPipelineCreateInfo.pNext = &renderingCreateInfo;
+
 
-		auto success = vkCreateGraphicsPipelines(*device, nullptr, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) == VK_SUCCESS;
+		auto success = vkCreateGraphicsPipelines(*device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) == VK_SUCCESS;
 		Assert(success, "Failed to create graphics pipeline");
 
 		for (auto shaderModule : shaderModules) { vkDestroyShaderModule(*device, shaderModule, nullptr); }
+		shaderModules.clear();
+
+		ready.store(true, std::memory_order_release);
 	}
 
-	Pipeline::Pipeline(VkDevice* device, ComputePipelineKey key)
+	Pipeline::Pipeline(VkDevice* device, VkPipelineCache pipelineCache, ComputePipelineKey key)
 	{
 		Assert(!(device == nullptr || key.program == nullptr), "Failed to obtain required information to create the graphics pipeline");
 
@@ -228,7 +333,9 @@ namespace Renderer
 		createInfo.stage = stage;
 		createInfo.layout = key.program->getPipelineLayout();
 
-		vkCreateComputePipelines(*device, nullptr, 1, &createInfo, nullptr, &pipeline);
+		vkCreateComputePipelines(*device, pipelineCache, 1, &createInfo, nullptr, &pipeline);
+
+		ready.store(true, std::memory_order_release);
 	}
 
 	VkShaderModule Pipeline::CreateShaderModule(Shader* shader)
@@ -258,42 +365,156 @@ namespace Renderer
 		return shaderCreateInfo;
 	}
 
-	void GraphicsPipelineCache::BindGraphicsPipeline(VkCommandBuffer buffer, VkRenderPass pass, const VkExtent2D& extent, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings,
-	                                                 const std::vector<BlendSettings>& blendSettings, VkPrimitiveTopology topology, ShaderProgram* program)
+	uint16_t GraphicsPipelineCache::GetProgramId(ShaderProgram* program)
 	{
-		GraphicsPipelineKey key;
-		key.renderpass = pass;
-		key.extent = extent;
-		key.depthSetting = depthSettings;
-		key.blendSettings = blendSettings;
-		key.topology = topology;
-		key.program = program;
-		key.vertexAttributes = vertexAttributes;
+		auto [id, inserted] = programIds.TryEmplace(program);
+
+		if (inserted && !freeProgramIds.empty())
+		{
+			*id = freeProgramIds.back();
+			freeProgramIds.pop_back();
+			programs[*id] = program;
+		}
+		else if (inserted)
+		{
+			Assert(programs.size() < UINT16_MAX, "Out of graphics pipeline program ids");
+
+			*id = static_cast<uint16_t>(programs.size());
+			programs.push_back(program);
+		}
 
-		BindGraphicsPipeline(buffer, key);
+		return *id;
 	}
 
-	void GraphicsPipelineCache::BindGraphicsPipeline(VkCommandBuffer buffer, GraphicsPipelineKey& key)
+	bool GraphicsPipelineCache::RetireProgram(ShaderProgram* program, const Defer& defer)
 	{
-		auto pipeline = Get(key)->GetPipeline();
+		auto* found = programIds.Find(program);
+		if (!found) return true;
+
+		const auto id = *found;
+		for (const auto& [key, entry] : cache)
+		{
+			if (key.program == id && IsPinned(entry.value)) return false;
+		}
+
+		// Nothing is left with the id, so the next program can have it
+		Retire([id](const GraphicsPipelineKey& key) { return key.program == id; }, defer);
+		programs[id] = nullptr;
+		programIds.Erase(program);
+		freeProgramIds.push_back(id);
 
-		vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		return true;
+	}
+
+	uint16_t GraphicsPipelineCache::GetVertexLayoutId(const VertexAttributes& vertexAttributes)
+	{
+		auto [id, inserted] = vertexLayoutIds.TryEmplace(vertexAttributes);
+
+		if (inserted)
+		{
+			*id = static_cast<uint16_t>(vertexLayouts.size());
+			vertexLayouts.push_back(vertexAttributes);
+		}
+
+		return *id;
+	}
+
+	GraphicsPipelineKey GraphicsPipelineCache::CreateKey(VkRenderPass pass, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings, const BlendSettings* blendSettings, uint32_t blendCount,
+	                                                     VkPrimitiveTopology topology, ShaderProgram* program)
+	{
+		return GraphicsPipelineKey(pass, GetProgramId(program), GetVertexLayoutId(vertexAttributes), depthSettings, blendSettings, blendCount, topology,
+		                           extendedDynamicState != nullptr);
+	}
+
+	GraphicsPipelineKey GraphicsPipelineCache::CreateKey(const std::vector<VkFormat>& colourFormats, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings,
+	                                                     const BlendSettings* blendSettings, uint32_t blendCount, VkPrimitiveTopology topology, ShaderProgram* program)
+	{
+		Assert(colourFormats.size() == blendCount, "Dynamic rendering pipelines need a blend setting per colour attachment");
+
+		return GraphicsPipelineKey(VK_NULL_HANDLE, GetProgramId(program), GetVertexLayoutId(vertexAttributes), depthSettings, blendSettings, blendCount,
+		                           topology, extendedDynamicState != nullptr, colourFormats.data());
+	}
+
+	GraphicsPipelineKey GraphicsPipelineCache::CreateKey(const GraphContext& context, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings,
+	                                                     const BlendSettings* blendSettings, uint32_t blendCount, VkPrimitiveTopology topology, ShaderProgram* program)
+	{
+		if (context.renderPass) return CreateKey(context.renderPass, vertexAttributes, depthSettings, blendSettings, blendCount, topology, program);
+
+		Assert(context.colourCount == blendCount, "Dynamic rendering pipelines need a blend setting per colour attachment");
+
+		return GraphicsPipelineKey(VK_NULL_HANDLE, GetProgramId(program), GetVertexLayoutId(vertexAttributes), depthSettings, blendSettings, blendCount,
+		                           topology, extendedDynamicState != nullptr, context.colourFormats);
+	}
+
+	bool GraphicsPipelineCache::BindGraphicsPipeline(VkCommandBuffer buffer, VkRenderPass pass, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings,
+	                                                 const BlendSettings* blendSettings, uint32_t blendCount, VkPrimitiveTopology topology, ShaderProgram* program)
+	{
+		return BindGraphicsPipeline(buffer, CreateKey(pass, vertexAttributes, depthSettings, blendSettings, blendCount, topology, program));
+	}
+
+	bool GraphicsPipelineCache::BindGraphicsPipeline(VkCommandBuffer buffer, const GraphicsPipelineKey& key)
+	{
+		auto* pipeline = TryGet(key);
+		if (!pipeline) pipeline = defaultPipeline;
+		if (!pipeline) return false;
+
+		vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->GetPipeline());
+
+		if (key.extendedDynamicState && extendedDynamicState)
+		{
+			// Same as the static state Compile would have baked in
+			extendedDynamicState->setCullMode(buffer, VK_CULL_MODE_NONE);
+			extendedDynamicState->setPrimitiveTopology(buffer, static_cast<VkPrimitiveTopology>(key.state.topology));
+			extendedDynamicState->setDepthTestEnable(buffer, VK_TRUE);
+			extendedDynamicState->setDepthWriteEnable(buffer, key.state.depthWrite);
+			extendedDynamicState->setDepthCompareOp(buffer, static_cast<VkCompareOp>(key.state.depthFunc));
+		}
+
+		return true;
+	}
+
+	void GraphicsPipelineCache::SetDefaultPipeline(const GraphicsPipelineKey& key)
+	{
+		// Only misses go to the compiler, an entry already queued there becomes ready eventually
+		defaultPipeline = FindOrEmplace(key, device, pipelineCache, key, programs[key.program], vertexLayouts[key.vertexLayout]);
+	}
+
+	Pipeline* GraphicsPipelineCache::Create(const GraphicsPipelineKey& key)
+	{
+		if (manifest) manifest->Record(key, programs[key.program], vertexLayouts[key.vertexLayout]);
+
+		if (!compiler) return arena.Create(device, pipelineCache, key, programs[key.program], vertexLayouts[key.vertexLayout]);
+
+		// The recording thread owns the table and the arena, workers only ever fill in the pipeline they're given
+		auto* pipeline = arena.Create(device, programs[key.program]);
+		compiler->Enqueue([pipeline, key, vertexAttributes = vertexLayouts[key.vertexLayout]](VkPipelineCache workerCache)
+		{
+			pipeline->Compile(workerCache, key, vertexAttributes);
+		});
+
+		return pipeline;
+	}
+
+	Pipeline* GraphicsPipelineCache::TryGet(const GraphicsPipelineKey& key)
+	{
+		auto* pipeline = Get(key);
+		return pipeline->IsReady() ? pipeline : nullptr;
 	}
 
 	Pipeline* GraphicsPipelineCache::Get(const GraphicsPipelineKey& key)
 	{
-		auto& pipeline = cache[key];
-		if (!pipeline) { pipeline = new Pipeline(device, key); }
+		auto* pipeline = TryCreate(key, [&] { return Create(key); }).first;
+		pipeline->prewarmed = false;
+
 		return pipeline;
 	}
 
 	bool GraphicsPipelineCache::Add(const GraphicsPipelineKey& key)
 	{
-		if (cache.find(key) != cache.end()) return false;
-
-		cache.emplace(key, new Pipeline(device, key));
+		auto [pipeline, created] = TryCreate(key, [&] { return Create(key); });
+		if (created) pipeline->prewarmed = true;
 
-		return true;
+		return created;
 	}
 
 	void ComputePipelineCache::BindComputePipeline(VkCommandBuffer buffer, ComputePipelineKey key)
@@ -305,16 +526,19 @@ namespace Renderer
 
 	Pipeline* ComputePipelineCache::Get(const ComputePipelineKey& key)
 	{
-		auto& pipeline = cache[key];
-		if (!pipeline) { pipeline = new Pipeline(device, key); }
-		return pipeline;
+		return TryCreate(key, [&]
+		{
+			if (manifest) manifest->Record(key);
+			return arena.Create(device, pipelineCache, key);
+		}).first;
 	}
 
 	bool ComputePipelineCache::Add(const ComputePipelineKey& key)
 	{
-		if (cache.find(key) != cache.end()) return false;
+		if (cache.Contains(key)) return false;
 
-		cache.emplace(key, new Pipeline(device, key));
+		if (manifest) manifest->Record(key);
+		Emplace(key, device, pipelineCache, key);
 
 		return true;
 	}
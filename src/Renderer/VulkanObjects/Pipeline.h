@@ -1,5 +1,6 @@
 #pragma once
 #include "vulkan.h"
+#include <atomic>
 #include <vector>
 #include <memory>
 
@@ -9,6 +10,10 @@
 namespace Renderer
 {
 	class ShaderProgram;
+	struct GraphContext;
+	class PipelineCompiler;
+	class PipelineManifest;
+	struct ExtendedDynamicState;
 	class Shader;
 	enum class ShaderType;
 
@@ -39,15 +44,60 @@ namespace Renderer
 		bool operator ==(const BlendSettings& other) const;
 	};
 
+	// BlendSettings squeezed into 32 bits, only the core blend ops and factors fit
+	struct PackedBlend
+	{
+		uint32_t enable : 1;
+		uint32_t colourOp : 3;
+		uint32_t alphaOp : 3;
+		uint32_t srcColour : 5;
+		uint32_t dstColour : 5;
+		uint32_t srcAlpha : 5;
+		uint32_t dstAlpha : 5;
+		uint32_t writeMask : 4;
+		uint32_t : 1;
+
+		static PackedBlend Pack(const BlendSettings& settings);
+		VkPipelineColorBlendAttachmentState Unpack() const;
+	};
+
+	// Everything a graphics pipeline is built from, packed flat so it can be copied, compared and hashed without touching the heap.
+	// Programs and vertex layouts are interned by the GraphicsPipelineCache, the formats come with the renderpass.
+	// Without a renderpass the pipeline is for dynamic rendering, and the colour formats are kept in the key instead
+	// Viewport and scissor are always dynamic, so the extent isn't part of it
 	struct GraphicsPipelineKey
 	{
-		ShaderProgram* program;
-		VkRenderPass renderpass;
-		VkExtent2D extent;
-		DepthSettings depthSetting;
-		VertexAttributes vertexAttributes;
-		std::vector<BlendSettings> blendSettings;
-		VkPrimitiveTopology topology;
+		static constexpr uint32_t maxColourAttachments = 4;
+
+		VkRenderPass renderpass = VK_NULL_HANDLE;
+		uint16_t program = 0;
+		uint16_t vertexLayout = 0;
+		// With extendedDynamicState only the topology class is kept and the depth state is left zeroed, they're set when binding
+		uint8_t topology = 0;
+		uint8_t depthFunc = 0;
+		uint8_t depthWrite = 0;
+		uint8_t attachmentCount = 0;
+		uint8_t extendedDynamicState = 0;
+		uint8_t padding[7] = {};
+		VkFormat colourFormats[maxColourAttachments] = {};
+		PackedBlend blend[maxColourAttachments] = {};
+
+		// Computed once on construction, everything above is hashed
+		uint64_t hash = 0;
+
+		// What was asked for, whichever parts of it ended up in the pipeline. Not part of the identity
+		struct
+		{
+			uint8_t topology = 0;
+			uint8_t depthFunc = 0;
+			uint8_t depthWrite = 0;
+		} state;
+
+		GraphicsPipelineKey() = default;
+		GraphicsPipelineKey(VkRenderPass renderpass, uint16_t program, uint16_t vertexLayout, const DepthSettings& depthSettings, const BlendSettings* blendSettings, uint32_t blendCount,
+		                    VkPrimitiveTopology topology, bool extendedDynamicState = false, const VkFormat* colourFormats = nullptr);
+
+		DepthSettings GetDepthSettings() const { return { static_cast<VkCompareOp>(state.depthFunc), state.depthWrite != 0 }; }
 
 		bool operator ==(const GraphicsPipelineKey& other) const;
 	};
@@ -67,11 +117,7 @@ namespace std
 	{
 		size_t operator()(const Renderer::GraphicsPipelineKey& s) const noexcept
 		{
-			size_t h1 = hash<uint32_t>{}(s.extent.width);
-			h1 = h1 ^ (hash<uint32_t>{}(s.extent.height) << 1);
-			h1 = h1 ^ (hash<uint64_t>{}(reinterpret_cast<uint64_t>(s.program)) << 1);
-			h1 = h1 ^ (hash<Renderer::VertexAttributes>{}(s.vertexAttributes) << 1);
-			return h1;
+			return s.hash;
 		}
 	};
 
@@ -86,25 +132,38 @@ namespace Renderer
 {
 	class Pipeline
 	{
+		friend class GraphicsPipelineCache;
 	private:
 		VkDevice* device;
 		ShaderProgram* program;
 
-		VkPipeline pipeline;
+		VkPipeline pipeline = VK_NULL_HANDLE;
 		VkPipelineLayout pipelineLayout;
 		std::vector<VkShaderModule> shaderModules;
 		std::vector<VkPushConstantRange> pushConstants;
 		VkDescriptorSetLayout descriptorSetLayout;
 
+		// Set once pipeline has been written, possibly by a compiler thread
+		std::atomic<bool> ready = false;
+
+		// Added ahead of time and not looked up since, see GraphicsPipelineCache::IsPinned
+		bool prewarmed = false;
+
 
 	public:
-		Pipeline(VkDevice* device, GraphicsPipelineKey key);
-		Pipeline(VkDevice* device, ComputePipelineKey key);
+		Pipeline(VkDevice* device, VkPipelineCache pipelineCache, const GraphicsPipelineKey& key, ShaderProgram* program, VertexAttributes vertexAttributes);
+		Pipeline(VkDevice* device, VkPipelineCache pipelineCache, ComputePipelineKey key);
+
+		// Only sets up the layouts, Compile creates the pipeline itself and can run on any thread
+		Pipeline(VkDevice* device, ShaderProgram* program);
+		void Compile(VkPipelineCache pipelineCache, const GraphicsPipelineKey& key, VertexAttributes vertexAttributes);
 
-		~Pipeline() { vkDestroyPipeline(*device, pipeline, nullptr); }
+		~Pipeline();
 
 		operator VkPipeline() { return pipeline; }
 
+		bool IsReady() const { return ready.load(std::memory_order_acquire); }
+
 		const VkPipeline& GetPipeline() { return pipeline; }
 		const VkPipelineLayout& GetLayout() { return pipelineLayout; }
 		const VkDescriptorSetLayout& GetDescriptorLayout() { return descriptorSetLayout; }
@@ -118,16 +177,76 @@ namespace Renderer
 	{
 	private:
 		VkDevice* device;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+		// Indexed by the ids stored in GraphicsPipelineKey
+		std::vector<ShaderProgram*> programs;
+		std::vector<VertexAttributes> vertexLayouts;
+		FlatMap<ShaderProgram*, uint16_t> programIds;
+		// Left by retired programs, handed to the next new one
+		std::vector<uint16_t> freeProgramIds;
+		FlatMap<VertexAttributes, uint16_t> vertexLayoutIds;
+
+		// When set, misses are compiled on its workers instead of the recording thread
+		PipelineCompiler* compiler = nullptr;
+		Pipeline* defaultPipeline = nullptr;
+
+		// Misses get recorded here when set, so the next run can create them up front
+		PipelineManifest* manifest = nullptr;
+
+		// Set when the device supports it and it was asked for, moves topology, depth and cull state out of the key
+		const ExtendedDynamicState* extendedDynamicState = nullptr;
+
+		Pipeline* Create(const GraphicsPipelineKey& key);
+
+		// Evicting a pipeline still being compiled would block on it, and prewarmed ones are kept until their first use
+		bool IsPinned(const Pipeline* pipeline) const override { return pipeline == defaultPipeline || pipeline->prewarmed || !pipeline->IsReady(); }
 
 	public:
-		void BuildCache(VkDevice* device) { this->device = device; }
+		void BuildCache(VkDevice* device, VkPipelineCache pipelineCache) { this->device = device; this->pipelineCache = pipelineCache; }
+
+		void SetCompiler(PipelineCompiler* compiler) { this->compiler = compiler; }
+		void SetManifest(PipelineManifest* manifest) { this->manifest = manifest; }
+
+		// Only affects keys created afterwards, pass nullptr to turn it off
+		void SetExtendedDynamicState(const ExtendedDynamicState* functions) { extendedDynamicState = functions; }
+
+		// Bound in place of pipelines which are still compiling, it has to be compatible with wherever it ends up being used.
+		// Compiled straight away
+		void SetDefaultPipeline(const GraphicsPipelineKey& key);
 
-		void BindGraphicsPipeline(VkCommandBuffer buffer, VkRenderPass pass, const VkExtent2D& extent, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings, const std::vector<BlendSettings>& blendSettings,
+		// ShaderProgramCache already hands everyone asking for the same shaders the same program, so the pointer is the identity
+		uint16_t GetProgramId(ShaderProgram* program);
+
+		// Retires every pipeline built from program and frees its id. False, leaving them all, while any is pinned, a
+		// compile still needs the program
+		bool RetireProgram(ShaderProgram* program, const Defer& defer);
+		uint16_t GetVertexLayoutId(const VertexAttributes& vertexAttributes);
+
+		// A blend setting per colour attachment, blendSettings only has to live for the call
+		GraphicsPipelineKey CreateKey(VkRenderPass pass, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings, const BlendSettings* blendSettings, uint32_t blendCount,
+		                              VkPrimitiveTopology topology, ShaderProgram* program);
+		// For dynamic rendering, a format per blend setting
+		GraphicsPipelineKey CreateKey(const std::vector<VkFormat>& colourFormats, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings,
+		                              const BlendSettings* blendSettings, uint32_t blendCount, VkPrimitiveTopology topology, ShaderProgram* program);
+		// Keys against whatever the pass is rendering with, its renderpass or its attachment formats
+		GraphicsPipelineKey CreateKey(const GraphContext& context, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings,
+		                              const BlendSettings* blendSettings, uint32_t blendCount, VkPrimitiveTopology topology, ShaderProgram* program);
+
+		bool BindGraphicsPipeline(VkCommandBuffer buffer, VkRenderPass pass, const VertexAttributes& vertexAttributes, const DepthSettings& depthSettings, const BlendSettings* blendSettings, uint32_t blendCount,
 		                          VkPrimitiveTopology topology, ShaderProgram* program);
-		void BindGraphicsPipeline(VkCommandBuffer buffer, GraphicsPipelineKey& key);
 
+		// Build the key once with CreateKey and keep it around, binding with it doesn't allocate.
+		// False if the pipeline is still compiling and there's no default, skip the draw
+		bool BindGraphicsPipeline(VkCommandBuffer buffer, const GraphicsPipelineKey& key);
+
+		// Never blocks, nullptr while the pipeline is still compiling
+		Pipeline* TryGet(const GraphicsPipelineKey& key);
+
+		// The pipeline may still be compiling when there's a compiler, check IsReady
 		Pipeline* Get(const GraphicsPipelineKey& key) override;
 
+		// For prewarming, the pipeline isn't evicted before the first Get for it
 		bool Add(const GraphicsPipelineKey& key) override;
 
 		void ClearEntry(Pipeline* pipeline) override { }
@@ -137,9 +256,12 @@ namespace Renderer
 	{
 	private:
 		VkDevice* device;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		PipelineManifest* manifest = nullptr;
 
 	public:
-		void BuildCache(VkDevice* device) { this->device = device; }
+		void BuildCache(VkDevice* device, VkPipelineCache pipelineCache) { this->device = device; this->pipelineCache = pipelineCache; }
+		void SetManifest(PipelineManifest* manifest) { this->manifest = manifest; }
 
 		void BindComputePipeline(VkCommandBuffer buffer, ComputePipelineKey key);
 
@@ -147,6 +269,8 @@ namespace Renderer
 
 		bool Add(const ComputePipelineKey& key) override;
 
+		void RetireProgram(ShaderProgram* program, const Defer& defer) { Retire([program](const ComputePipelineKey& key) { return key.program == program; }, defer); }
+
 		void ClearEntry(Pipeline* pipeline) override { }
 	};
 }
@@ -0,0 +1,129 @@
+#include "PipelineCache.h"
+#include "Device.h"
+#include "../../Utils/File.h"
+#include "../../Utils/Logging.h"
+#include <cstring>
+#include <fstream>
+
+namespace Renderer
+{
+	// Layout of the header every driver puts at the start of its cache data, older SDK headers don't declare it
+	struct PipelineCacheHeader
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	bool PipelineCache::IsCompatible(const std::vector<char>& data) const
+	{
+		if (data.size() < sizeof(PipelineCacheHeader)) return false;
+
+		PipelineCacheHeader header;
+		std::memcpy(&header, data.data(), sizeof(header));
+
+		return header.headerSize >= sizeof(PipelineCacheHeader) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+			std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	void PipelineCache::Load(Device* device, const std::string& path)
+	{
+		this->device = *device;
+		this->path = path;
+		properties = device->GetPhysicalDeviceProperties();
+
+		auto data = std::vector<char>();
+
+		if (!path.empty())
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+			if (file.is_open())
+			{
+				data.resize(static_cast<size_t>(file.tellg()));
+				file.seekg(0);
+				file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+				// A new driver or GPU invalidates the lot, the driver would reject it anyway but not all of them do so gracefully
+				if (!IsCompatible(data))
+				{
+					LogInfo("Pipeline cache doesn't match this device or driver, starting from empty");
+					data.clear();
+				}
+			}
+		}
+
+		VkPipelineCacheCreateInfo info = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		info.initialDataSize = data.size();
+		info.pInitialData = data.empty() ? nullptr : data.data();
+
+		auto success = vkCreatePipelineCache(this->device, &info, nullptr, &cache);
+
+		if (success != VK_SUCCESS && !data.empty())
+		{
+			LogWarning("Failed to create pipeline cache from file, starting from empty");
+
+			info.initialDataSize = 0;
+			info.pInitialData = nullptr;
+			success = vkCreatePipelineCache(this->device, &info, nullptr, &cache);
+		}
+
+		Assert(success == VK_SUCCESS, "Failed to create pipeline cache");
+	}
+
+	void PipelineCache::Save()
+	{
+		if (cache == VK_NULL_HANDLE || path.empty()) return;
+
+		size_t size = 0;
+		vkGetPipelineCacheData(device, cache, &size, nullptr);
+
+		auto data = std::vector<char>(size);
+		if (size == 0 || vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) return;
+
+		WriteFileAtomically(path, data.data(), size, "pipeline cache file");
+	}
+
+	void PipelineCache::Destroy()
+	{
+		if (cache != VK_NULL_HANDLE) vkDestroyPipelineCache(device, cache, nullptr);
+		cache = VK_NULL_HANDLE;
+	}
+
+	VkPipelineCache PipelineCache::CreateWorkerCache()
+	{
+		// Seeded with everything the main cache holds, so pipelines loaded from disk are hits on the workers too
+		auto data = std::vector<char>();
+		{
+			std::lock_guard lock(mutex);
+
+			size_t size = 0;
+			vkGetPipelineCacheData(device, cache, &size, nullptr);
+			data.resize(size);
+			if (size == 0 || vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) data.clear();
+		}
+
+		VkPipelineCacheCreateInfo info = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		info.initialDataSize = data.size();
+		info.pInitialData = data.empty() ? nullptr : data.data();
+
+		VkPipelineCache workerCache;
+		const auto success = vkCreatePipelineCache(device, &info, nullptr, &workerCache);
+		Assert(success == VK_SUCCESS, "Failed to create worker pipeline cache");
+
+		return workerCache;
+	}
+
+	void PipelineCache::Merge(VkPipelineCache workerCache)
+	{
+		{
+			std::lock_guard lock(mutex);
+			vkMergePipelineCaches(device, cache, 1, &workerCache);
+		}
+
+		vkDestroyPipelineCache(device, workerCache, nullptr);
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "vulkan.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Renderer
+{
+	class Device;
+
+	// Renderer wide VkPipelineCache, persisted between runs. The file is only used when its header matches
+	// the vendor, device and pipeline cache UUID we're running on, anything else is thrown away and rebuilt.
+	class PipelineCache
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties properties = {};
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		std::string path;
+
+		std::mutex mutex;
+
+		bool IsCompatible(const std::vector<char>& data) const;
+
+	public:
+		PipelineCache() = default;
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+
+		operator VkPipelineCache() const { return cache; }
+
+		// An empty path keeps the cache in memory only
+		void Load(Device* device, const std::string& path);
+		void Save();
+		void Destroy();
+
+		// Worker threads compile into their own cache so they never contend on the main one, merge them back when they're done.
+		// Each starts out with a copy of the main cache's data
+		VkPipelineCache CreateWorkerCache();
+		void Merge(VkPipelineCache workerCache);
+	};
+}
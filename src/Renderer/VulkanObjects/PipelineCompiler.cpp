@@ -0,0 +1,57 @@
+#include "PipelineCompiler.h"
+#include "PipelineCache.h"
+
+namespace Renderer
+{
+	PipelineCompiler::PipelineCompiler(PipelineCache* pipelineCache, uint32_t threadCount) : pipelineCache(pipelineCache)
+	{
+		workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) workers.emplace_back(&PipelineCompiler::Work, this);
+	}
+
+	PipelineCompiler::~PipelineCompiler()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+
+		condition.notify_all();
+		for (auto& worker : workers) worker.join();
+	}
+
+	void PipelineCompiler::Enqueue(std::function<void(VkPipelineCache)> job)
+	{
+		{
+			std::lock_guard lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+
+		condition.notify_one();
+	}
+
+	void PipelineCompiler::Work()
+	{
+		auto workerCache = pipelineCache->CreateWorkerCache();
+
+		while (true)
+		{
+			std::function<void(VkPipelineCache)> job;
+
+			{
+				std::unique_lock lock(mutex);
+				condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+				// Drain the queue before stopping, pipelines waiting on these would never become ready otherwise
+				if (jobs.empty()) break;
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			job(workerCache);
+		}
+
+		pipelineCache->Merge(workerCache);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "vulkan.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Renderer
+{
+	class PipelineCache;
+
+	// Worker threads which compile pipelines off the recording thread. Every worker compiles into its own
+	// VkPipelineCache, seeded from the renderer wide one and merged back into it when the compiler is destroyed.
+	class PipelineCompiler
+	{
+		PipelineCache* pipelineCache;
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void(VkPipelineCache)>> jobs;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping = false;
+
+		void Work();
+
+	public:
+		PipelineCompiler(PipelineCache* pipelineCache, uint32_t threadCount);
+		PipelineCompiler(const PipelineCompiler&) = delete;
+		PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+		// Finishes every queued job before returning, nothing may be left half compiled
+		~PipelineCompiler();
+
+		// job is handed the worker's pipeline cache
+		void Enqueue(std::function<void(VkPipelineCache)> job);
+	};
+}
@@ -0,0 +1,350 @@
+#include "PipelineManifest.h"
+#include "Renderpass.h"
+#include "../Resources/ShaderManager.h"
+#include "../../Utils/File.h"
+#include "../../Utils/Logging.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace Renderer
+{
+	static constexpr uint32_t manifestMagic = 0x4E414D50; // "PMAN"
+	static constexpr uint32_t manifestVersion = 3;
+
+	static constexpr char graphicsTag = 'G';
+	static constexpr char computeTag = 'C';
+
+	template <class T>
+	static void Write(std::string& out, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static void Write(std::string& out, const std::string& value)
+	{
+		Write(out, static_cast<uint32_t>(value.size()));
+		out.append(value);
+	}
+
+	template <class T>
+	static void Write(std::string& out, const std::vector<T>& values)
+	{
+		Write(out, static_cast<uint32_t>(values.size()));
+		for (const auto& value : values) Write(out, value);
+	}
+
+	// Reads back what Write produced, failing rather than reading past the end of a truncated or stale record
+	class ManifestReader
+	{
+		const std::string& data;
+		size_t offset = 0;
+
+	public:
+		bool failed = false;
+
+		ManifestReader(const std::string& data) : data(data) { }
+
+		template <class T>
+		void Read(T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			if (failed || offset + sizeof(T) > data.size())
+			{
+				failed = true;
+				return;
+			}
+
+			std::memcpy(&value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+		}
+
+		void Read(std::string& value)
+		{
+			uint32_t size = 0;
+			Read(size);
+			if (failed || offset + size > data.size())
+			{
+				failed = true;
+				return;
+			}
+
+			value.assign(data, offset, size);
+			offset += size;
+		}
+
+		template <class T>
+		void Read(std::vector<T>& values)
+		{
+			uint32_t size = 0;
+			Read(size);
+			if (failed || size > data.size() - offset)
+			{
+				failed = true;
+				return;
+			}
+
+			values.resize(size);
+			for (auto& value : values) Read(value);
+		}
+
+		bool Done() const { return !failed && offset == data.size(); }
+	};
+
+	static std::vector<std::pair<ShaderType, std::string>> GetShaderPaths(ShaderProgram* program)
+	{
+		std::vector<std::pair<ShaderType, std::string>> shaders;
+		for (const auto* shader : program->getShaders()) shaders.emplace_back(shader->getType(), shader->getPath());
+
+		return shaders;
+	}
+
+	static void WriteShaders(std::string& out, const std::vector<std::pair<ShaderType, std::string>>& shaders)
+	{
+		Write(out, static_cast<uint32_t>(shaders.size()));
+		for (const auto& [type, path] : shaders)
+		{
+			Write(out, type);
+			Write(out, path);
+		}
+	}
+
+	static void ReadShaders(ManifestReader& reader, std::vector<std::pair<ShaderType, std::string>>& shaders)
+	{
+		uint32_t count = 0;
+		reader.Read(count);
+		if (reader.failed) return;
+
+		for (uint32_t i = 0; i < count && !reader.failed; i++)
+		{
+			auto& [type, path] = shaders.emplace_back();
+			reader.Read(type);
+			reader.Read(path);
+		}
+	}
+
+	// Shaders renamed or removed since the record was written, it can never be rebuilt
+	static bool ShadersExist(const std::vector<std::pair<ShaderType, std::string>>& shaders)
+	{
+		std::error_code error;
+		return std::all_of(shaders.begin(), shaders.end(), [&](const auto& shader) { return std::filesystem::exists(shader.second, error); });
+	}
+
+	void PipelineManifest::Load(const std::string& path, RenderpassCache* renderpassCache, ShaderManager* shaderManager)
+	{
+		this->path = path;
+		this->renderpassCache = renderpassCache;
+		this->shaderManager = shaderManager;
+
+		if (path.empty()) return;
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) return;
+
+		auto data = std::string(static_cast<size_t>(file.tellg()), '\0');
+		file.seekg(0);
+		file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+		ManifestReader reader(data);
+		uint32_t magic = 0, version = 0;
+		std::vector<std::string> records;
+		reader.Read(magic);
+		reader.Read(version);
+
+		if (magic != manifestMagic || version != manifestVersion)
+		{
+			LogInfo("Pipeline manifest is from another version, starting from empty");
+			return;
+		}
+
+		reader.Read(records);
+		if (!reader.Done())
+		{
+			LogWarning("Pipeline manifest is corrupt, starting from empty");
+			return;
+		}
+
+		for (auto& record : records)
+		{
+			if (record.empty() || !recorded.insert(record).second) continue;
+
+			if (record[0] == graphicsTag) graphicsRecords.push_back(std::move(record));
+			else if (record[0] == computeTag) computeRecords.push_back(std::move(record));
+		}
+	}
+
+	void PipelineManifest::Save()
+	{
+		if (path.empty()) return;
+
+		std::string data;
+		Write(data, manifestMagic);
+		Write(data, manifestVersion);
+		Write(data, static_cast<uint32_t>(graphicsRecords.size() + computeRecords.size()));
+		for (const auto& record : graphicsRecords) Write(data, record);
+		for (const auto& record : computeRecords) Write(data, record);
+
+		WriteFileAtomically(path, data.data(), data.size(), "pipeline manifest");
+	}
+
+	void PipelineManifest::Record(const GraphicsPipelineKey& key, ShaderProgram* program, const VertexAttributes& vertexAttributes)
+	{
+		// Dynamic rendering pipelines are rebuilt from the formats in the key
+		const uint8_t dynamicRendering = key.renderpass == VK_NULL_HANDLE ? 1 : 0;
+		const auto* renderpass = renderpassCache && !dynamicRendering ? renderpassCache->FindKey(key.renderpass) : nullptr;
+
+		// Renderpasses from outside the cache (imgui's for one) can't be rebuilt on the next run
+		if (!renderpass && !dynamicRendering) return;
+
+		std::string record(1, graphicsTag);
+		Write(record, dynamicRendering);
+		Write(record, renderpass ? renderpass->colourAttachments : std::vector<AttachmentDesc>());
+		Write(record, renderpass ? renderpass->depthAttachment : AttachmentDesc{});
+		Write(record, key.colourFormats);
+		WriteShaders(record, GetShaderPaths(program));
+		Write(record, vertexAttributes.bindings);
+		Write(record, vertexAttributes.attributes);
+		Write(record, key.state.topology);
+		Write(record, key.state.depthFunc);
+		Write(record, key.state.depthWrite);
+		Write(record, key.attachmentCount);
+		Write(record, key.blend);
+
+		if (recorded.insert(record).second) graphicsRecords.push_back(std::move(record));
+	}
+
+	void PipelineManifest::Record(const ComputePipelineKey& key)
+	{
+		std::string record(1, computeTag);
+		WriteShaders(record, GetShaderPaths(key.program));
+
+		if (recorded.insert(record).second) computeRecords.push_back(std::move(record));
+	}
+
+	ShaderProgram* PipelineManifest::GetProgram(const std::vector<std::pair<ShaderType, std::string>>& shaders)
+	{
+		auto& program = programs[shaders];
+
+		if (!program)
+		{
+			std::vector<Shader*> programShaders;
+			for (const auto& [type, path] : shaders) programShaders.push_back(shaderManager->get(type, path));
+
+			program = shaderManager->getProgram(programShaders);
+		}
+
+		return program;
+	}
+
+	uint32_t PipelineManifest::Prewarm(GraphicsPipelineCache* graphicsCache, ComputePipelineCache* computeCache)
+	{
+		Assert(renderpassCache && shaderManager, "Pipeline manifest has to be loaded before prewarming");
+
+		uint32_t added = 0;
+
+		// Records which can't be rebuilt any more are dropped, and aren't written back by Save
+		std::vector<std::string> kept;
+		kept.reserve(graphicsRecords.size());
+
+		for (auto& record : graphicsRecords)
+		{
+			ManifestReader reader(record);
+			char tag;
+			uint8_t dynamicRendering;
+			std::vector<AttachmentDesc> colourAttachments;
+			AttachmentDesc depthAttachment;
+			VkFormat colourFormats[GraphicsPipelineKey::maxColourAttachments];
+			std::vector<std::pair<ShaderType, std::string>> shaders;
+			std::vector<VertexAttributes::Binding> bindings;
+			std::vector<VertexAttributes::Attribute> attributes;
+			uint8_t topology, depthFunc, depthWrite, attachmentCount;
+			PackedBlend blend[GraphicsPipelineKey::maxColourAttachments];
+
+			reader.Read(tag);
+			reader.Read(dynamicRendering);
+			reader.Read(colourAttachments);
+			reader.Read(depthAttachment);
+			reader.Read(colourFormats);
+			ReadShaders(reader, shaders);
+			reader.Read(bindings);
+			reader.Read(attributes);
+			reader.Read(topology);
+			reader.Read(depthFunc);
+			reader.Read(depthWrite);
+			reader.Read(attachmentCount);
+			reader.Read(blend);
+
+			if (!reader.Done() || attachmentCount > GraphicsPipelineKey::maxColourAttachments)
+			{
+				LogWarning("Dropping unreadable graphics pipeline from manifest");
+				recorded.erase(record);
+				continue;
+			}
+
+			if (!ShadersExist(shaders))
+			{
+				recorded.erase(record);
+				continue;
+			}
+
+			BlendSettings blendSettings[GraphicsPipelineKey::maxColourAttachments];
+			for (uint32_t i = 0; i < attachmentCount; i++) blendSettings[i].blendState = blend[i].Unpack();
+
+			auto vertexAttributes = VertexAttributes(std::move(bindings), std::move(attributes));
+			const DepthSettings depthSettings = { static_cast<VkCompareOp>(depthFunc), depthWrite != 0 };
+
+			GraphicsPipelineKey key;
+			if (dynamicRendering)
+			{
+				key = graphicsCache->CreateKey(std::vector<VkFormat>(colourFormats, colourFormats + attachmentCount), vertexAttributes, depthSettings, blendSettings, attachmentCount,
+				                               static_cast<VkPrimitiveTopology>(topology), GetProgram(shaders));
+			}
+			else
+			{
+				auto* renderpass = renderpassCache->Get(RenderpassKey(std::move(colourAttachments), depthAttachment));
+				key = graphicsCache->CreateKey(renderpass->GetHandle(), vertexAttributes, depthSettings, blendSettings, attachmentCount, static_cast<VkPrimitiveTopology>(topology), GetProgram(shaders));
+			}
+
+			if (graphicsCache->Add(key)) ++added;
+			kept.push_back(std::move(record));
+		}
+
+		graphicsRecords = std::move(kept);
+		if (!computeCache) return added;
+
+		kept.clear();
+		kept.reserve(computeRecords.size());
+
+		for (auto& record : computeRecords)
+		{
+			ManifestReader reader(record);
+			char tag;
+			std::vector<std::pair<ShaderType, std::string>> shaders;
+
+			reader.Read(tag);
+			ReadShaders(reader, shaders);
+
+			if (!reader.Done())
+			{
+				LogWarning("Dropping unreadable compute pipeline from manifest");
+				recorded.erase(record);
+				continue;
+			}
+
+			if (!ShadersExist(shaders))
+			{
+				recorded.erase(record);
+				continue;
+			}
+
+			if (computeCache->Add({ GetProgram(shaders) })) ++added;
+			kept.push_back(std::move(record));
+		}
+
+		computeRecords = std::move(kept);
+		return added;
+	}
+}
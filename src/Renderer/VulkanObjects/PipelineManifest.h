@@ -0,0 +1,49 @@
+#pragma once
+#include "Pipeline.h"
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Renderer
+{
+	class RenderpassCache;
+	class ShaderManager;
+
+	// Every pipeline key the caches missed on, written out with what's needed to rebuild it on another run:
+	// the renderpass description, the shader paths of the program, the vertex layout and the fixed function state.
+	// Prewarm creates all of them up front so the first frames don't have to.
+	class PipelineManifest
+	{
+		RenderpassCache* renderpassCache = nullptr;
+		ShaderManager* shaderManager = nullptr;
+		std::string path;
+
+		// Records are kept serialised, which doubles as the key for spotting duplicates
+		std::vector<std::string> graphicsRecords;
+		std::vector<std::string> computeRecords;
+		std::unordered_set<std::string> recorded;
+
+		// Programs acquired while prewarming, by shader list. The references are held until the ShaderManager goes, so they
+		// outlive the pipelines built from them, and are the same programs the application gets for those shaders
+		std::map<std::vector<std::pair<ShaderType, std::string>>, ShaderProgram*> programs;
+
+		ShaderProgram* GetProgram(const std::vector<std::pair<ShaderType, std::string>>& shaders);
+
+	public:
+		// An empty path keeps the manifest in memory only
+		void Load(const std::string& path, RenderpassCache* renderpassCache, ShaderManager* shaderManager);
+		void Save();
+
+		void Record(const GraphicsPipelineKey& key, ShaderProgram* program, const VertexAttributes& vertexAttributes);
+		void Record(const ComputePipelineKey& key);
+
+		// Adds every recorded pipeline to the caches, returns how many were new. With a compiler set on the
+		// graphics cache they compile in parallel and may still be compiling when this returns. Records whose shaders
+		// have been renamed or removed are dropped from the manifest
+		uint32_t Prewarm(GraphicsPipelineCache* graphicsCache, ComputePipelineCache* computeCache = nullptr);
+
+		size_t Size() const { return graphicsRecords.size() + computeRecords.size(); }
+	};
+}
@@ -35,8 +35,9 @@ namespace Renderer
 			desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 			desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 			desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			desc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			// Presenting (or not, when headless) is left to whoever owns the image, so attachments stay in attachment layout
+			desc.initialLayout = colourAttachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+			desc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 			attachmentRefs.push_back(ref);
 			attachmentDescriptions.push_back(desc);
@@ -97,17 +98,25 @@ namespace Renderer
 
 	bool RenderpassCache::Add(const RenderpassKey& key)
 	{
-		if (cache.find(key) != cache.end()) return false;
+		if (cache.Contains(key)) return false;
 
-		cache.emplace(key, new Renderpass(device, key));
+		Emplace(key, device, key);
 
 		return true;
 	}
 
 	Renderpass* RenderpassCache::Get(const RenderpassKey& key)
 	{
-		auto& renderPass = cache[key];
-		if (!renderPass) { renderPass = new Renderpass(device, key); }
-		return renderPass;
+		return FindOrEmplace(key, device, key);
+	}
+
+	const RenderpassKey* RenderpassCache::FindKey(VkRenderPass renderpass)
+	{
+		for (const auto& [key, entry] : cache)
+		{
+			if (entry.value->GetHandle() == renderpass) return &key;
+		}
+
+		return nullptr;
 	}
 }
@@ -72,6 +72,9 @@ namespace Renderer
 		bool Add(const RenderpassKey& key) override;
 		void ClearEntry(Renderpass* renderpass) override;
 
+		// Reverse lookup, walks the whole cache
+		const RenderpassKey* FindKey(VkRenderPass renderpass);
+
 	private:
 		VkDevice* device;
 	};
@@ -0,0 +1,71 @@
+#include "SamplerCache.h"
+#include "../../Utils/Logging.h"
+#include <tuple>
+
+namespace Renderer
+{
+	// -0.0 compares equal to 0.0 but has other bits
+	static float Normalise(float value) { return value == 0.0f ? 0.0f : value; }
+
+	SamplerKey::SamplerKey(const VkSamplerCreateInfo& info)
+		: magFilter(info.magFilter), minFilter(info.minFilter), mipmapMode(info.mipmapMode), addressModeU(info.addressModeU), addressModeV(info.addressModeV),
+		  addressModeW(info.addressModeW), mipLodBias(Normalise(info.mipLodBias)), anisotropyEnable(info.anisotropyEnable ? VK_TRUE : VK_FALSE),
+		  maxAnisotropy(info.anisotropyEnable ? Normalise(info.maxAnisotropy) : 0.0f), compareEnable(info.compareEnable ? VK_TRUE : VK_FALSE),
+		  compareOp(info.compareEnable ? info.compareOp : VK_COMPARE_OP_NEVER), minLod(Normalise(info.minLod)), maxLod(Normalise(info.maxLod)), borderColor(info.borderColor),
+		  unnormalizedCoordinates(info.unnormalizedCoordinates ? VK_TRUE : VK_FALSE) { }
+
+	VkSamplerCreateInfo SamplerKey::CreateInfo() const
+	{
+		VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+		samplerInfo.magFilter = magFilter;
+		samplerInfo.minFilter = minFilter;
+		samplerInfo.mipmapMode = mipmapMode;
+		samplerInfo.addressModeU = addressModeU;
+		samplerInfo.addressModeV = addressModeV;
+		samplerInfo.addressModeW = addressModeW;
+		samplerInfo.mipLodBias = mipLodBias;
+		samplerInfo.anisotropyEnable = anisotropyEnable;
+		samplerInfo.maxAnisotropy = maxAnisotropy;
+		samplerInfo.compareEnable = compareEnable;
+		samplerInfo.compareOp = compareOp;
+		samplerInfo.minLod = minLod;
+		samplerInfo.maxLod = maxLod;
+		samplerInfo.borderColor = borderColor;
+		samplerInfo.unnormalizedCoordinates = unnormalizedCoordinates;
+
+		return samplerInfo;
+	}
+
+	bool SamplerKey::operator==(const SamplerKey& other) const
+	{
+		return std::tie(magFilter, minFilter, mipmapMode, addressModeU, addressModeV, addressModeW, mipLodBias, anisotropyEnable, maxAnisotropy, compareEnable, compareOp, minLod, maxLod, borderColor,
+			       unnormalizedCoordinates) == std::tie(other.magFilter, other.minFilter, other.mipmapMode, other.addressModeU, other.addressModeV, other.addressModeW, other.mipLodBias,
+			       other.anisotropyEnable, other.maxAnisotropy, other.compareEnable, other.compareOp, other.minLod, other.maxLod, other.borderColor, other.unnormalizedCoordinates);
+	}
+
+	void SamplerCache::BuildCache(VkDevice* device, uint32_t maxSamplers)
+	{
+		this->device = device;
+		this->maxSamplers = maxSamplers;
+	}
+
+	Sampler* SamplerCache::Get(const SamplerKey& key)
+	{
+		auto [sampler, created] = TryCreate(key, [&] { return arena.Create(device, key.CreateInfo()); });
+		if (created && cache.Size() > maxSamplers) LogWarning("{} distinct samplers, the device only guarantees {}", cache.Size(), maxSamplers);
+
+		return sampler;
+	}
+
+	bool SamplerCache::Add(const SamplerKey& key)
+	{
+		if (cache.Contains(key)) return false;
+
+		Emplace(key, device, key.CreateInfo());
+
+		return true;
+	}
+
+	// Destroying the sampler is all there is to it
+	void SamplerCache::ClearEntry(Sampler* sampler) { }
+}
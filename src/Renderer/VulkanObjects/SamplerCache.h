@@ -0,0 +1,86 @@
+#pragma once
+#include <cstring>
+#include <vulkan_core.h>
+#include "Cache.h"
+#include "../Resources/Sampler.h"
+
+namespace Renderer
+{
+	// Everything in VkSamplerCreateInfo which makes two samplers behave differently. State the sampler ignores is zeroed and
+	// -0.0 is stored as 0.0, so samplers which behave the same compare and hash the same
+	struct SamplerKey
+	{
+		SamplerKey(const VkSamplerCreateInfo& info);
+
+		VkFilter magFilter;
+		VkFilter minFilter;
+		VkSamplerMipmapMode mipmapMode;
+		VkSamplerAddressMode addressModeU;
+		VkSamplerAddressMode addressModeV;
+		VkSamplerAddressMode addressModeW;
+		float mipLodBias;
+		VkBool32 anisotropyEnable;
+		float maxAnisotropy;
+		VkBool32 compareEnable;
+		VkCompareOp compareOp;
+		float minLod;
+		float maxLod;
+		VkBorderColor borderColor;
+		VkBool32 unnormalizedCoordinates;
+
+		VkSamplerCreateInfo CreateInfo() const;
+
+		bool operator ==(const SamplerKey& other) const;
+
+		// Bit pattern of an already normalised float, for hashing
+		static uint32_t Bits(float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+	};
+}
+
+namespace std
+{
+	template <>
+	struct hash<Renderer::SamplerKey>
+	{
+		size_t operator()(const Renderer::SamplerKey& s) const noexcept
+		{
+			using Key = Renderer::SamplerKey;
+			const uint32_t fields[] = { static_cast<uint32_t>(s.magFilter), static_cast<uint32_t>(s.minFilter), static_cast<uint32_t>(s.mipmapMode), static_cast<uint32_t>(s.addressModeU),
+			                            static_cast<uint32_t>(s.addressModeV), static_cast<uint32_t>(s.addressModeW), Key::Bits(s.mipLodBias), s.anisotropyEnable, Key::Bits(s.maxAnisotropy),
+			                            s.compareEnable, static_cast<uint32_t>(s.compareOp), Key::Bits(s.minLod), Key::Bits(s.maxLod), static_cast<uint32_t>(s.borderColor),
+			                            s.unnormalizedCoordinates };
+
+			size_t h1 = 0;
+			for (auto field : fields) h1 ^= hash<uint32_t>{}(field) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2);
+
+			return h1;
+		}
+	};
+}
+
+namespace Renderer
+{
+	// Samplers shared between everything asking for the same state, devices only allow so many of them
+	class SamplerCache : public RefCountedCache<Sampler, SamplerKey>
+	{
+	public:
+		void BuildCache(VkDevice* device, uint32_t maxSamplers);
+
+		using RefCountedCache::Acquire;
+		Sampler* Acquire(VkSamplerAddressMode addressMode, VkFilter filter, VkSamplerMipmapMode mipFilter) { return Acquire(Sampler::CreateInfo(addressMode, filter, mipFilter)); }
+
+		Sampler* Get(const SamplerKey& key) override;
+		bool Add(const SamplerKey& key) override;
+
+	private:
+		VkDevice* device;
+		uint32_t maxSamplers = 0;
+
+		void ClearEntry(Sampler* sampler) override;
+	};
+}
@@ -2,12 +2,15 @@
 #include "glfw3.h"
 #include "../../Utils/Logging.h"
 #include "../Memory/Image.h"
+#include "../Memory/Allocator.h"
 
 namespace Renderer
 {
 
 	Swapchain::~Swapchain()
 	{
+		if (headless) return;
+		
 		for (auto image : images)
 		{
 			vkDestroyImageView(*device, image->GetView(), nullptr);
@@ -42,6 +45,8 @@ namespace Renderer
 		glfwInit();
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
+		this->width = width;
+		this->height = height;
 		window = glfwCreateWindow(width, height, title, nullptr, nullptr);
 		Assert(window != nullptr, "Failed to create window");
 	}
@@ -52,7 +57,7 @@ namespace Renderer
 		Assert(success == VK_SUCCESS, "Failed to initialise window surface");
 	}
 
-	void Swapchain::BuildSwapchain(bool vsync)
+	void Swapchain::BuildSwapchain(bool vsync, Memory::Allocator* allocator)
 	{
 		VkSwapchainKHR oldSwapchain = swapchain;
 
@@ -149,24 +154,35 @@ namespace Renderer
 
 		if (oldSwapchain != nullptr)
 		{
+			auto views = std::vector<VkImageView>();
 			for (auto image : images)
 			{
-				vkDestroyImageView(*device, image->GetView(), nullptr);
+				views.push_back(image->GetView());
 				delete image;
 			}
 
-			vkDestroySwapchainKHR(*device, oldSwapchain, nullptr);
+			auto retire = [views, oldSwapchain](VkDevice device)
+			{
+				for (auto view : views) vkDestroyImageView(device, view, nullptr);
+				vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+			};
+
+			if (allocator) allocator->Defer(retire);
+			else retire(*device);
 		}
 
 		std::vector<VkImage> tempImages;
-		vkGetSwapchainImagesKHR(*device, swapchain, &framesInFlight, nullptr);
-		tempImages.resize(framesInFlight);
-		vkGetSwapchainImagesKHR(*device, swapchain, &framesInFlight, tempImages.data());
+		vkGetSwapchainImagesKHR(*device, swapchain, &imageCount, nullptr);
+		tempImages.resize(imageCount);
+		vkGetSwapchainImagesKHR(*device, swapchain, &imageCount, tempImages.data());
+
+		if (framesInFlight == 0) framesInFlight = imageCount;
+		imagesInFlight.assign(imageCount, nullptr);
 
 		// Get the swap chain buffers containing the image and imageview
-		images.resize(framesInFlight);
+		images.resize(imageCount);
 
-		for (uint32_t i = 0; i < framesInFlight; i++)
+		for (uint32_t i = 0; i < imageCount; i++)
 		{
 			VkImageView view;
 			
@@ -189,12 +205,42 @@ namespace Renderer
 
 			vkCreateImageView(*device, &colorAttachmentView, nullptr, &view);
 			
-			images[i] = new Memory::Image(tempImages[i], view, subResourceRange, VkExtent3D{extent.width, extent.height, 1}, color.format);
+			images[i] = new Memory::Image(tempImages[i], view, subResourceRange, VkExtent3D{extent.width, extent.height, 1}, color.format, swapchainCI.imageUsage);
 		}
 
 		tempImages.clear();
 	}
 
+	void Swapchain::BuildHeadless(Memory::Allocator* allocator, int width, int height)
+	{
+		headless = true;
+		
+		this->width = width;
+		this->height = height;
+		extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+		color = { VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+
+		// One image per frame slot, so there's nothing to map
+		Assert(framesInFlight > 0, "Headless needs an explicit frames in flight");
+		imageCount = framesInFlight;
+		imagesInFlight.assign(imageCount, nullptr);
+		
+		images.resize(imageCount);
+
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			images[i] = allocator->AllocateImage(extent, color.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+	}
+
+	void Swapchain::DestroyHeadless()
+	{
+		// The allocator cleans these up, so they have to go before it does
+		for (auto image : images) delete image;
+		images.clear();
+	}
+
 	void Swapchain::BuildSyncObjects()
 	{
 		frames.resize(framesInFlight);
@@ -217,19 +263,35 @@ namespace Renderer
 		}
 	}
 
-	FrameInfo Swapchain::BeginFrame(VkCommandBuffer buffer)
+	VkResult Swapchain::BeginFrame(VkCommandBuffer buffer, FrameInfo& info)
 	{
 		auto& curFrame = frames[currentIndex];
 		curFrame.buffer = buffer;
 
 		VkFence waitFences[] = { curFrame.inFlightFence };
 		vkWaitForFences(*device, 1, waitFences, VK_TRUE, UINT64_MAX);
+
+		// Offscreen images are only used by their frame, so waiting on its fence is enough
+		uint32_t imageIndex = currentIndex;
+		if (!headless)
+		{
+			const auto result = vkAcquireNextImageKHR(*device, swapchain, UINT64_MAX, curFrame.imageAcquired, nullptr, &imageIndex);
+
+			// Nothing was submitted, so the fence has to stay signalled for the next attempt
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) return result;
+			Assert(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failed to acquire swapchain image");
+		}
+		
 		vkResetFences(*device, 1, &curFrame.inFlightFence);
 
-		uint32_t imageIndex = 0;
-		vkAcquireNextImageKHR(*device, swapchain, UINT64_MAX, curFrame.imageAcquired, nullptr, &imageIndex);
+		// Images and frame slots don't line up, so the image can still be in use by another slot
+		if (imagesInFlight[imageIndex] != nullptr && imagesInFlight[imageIndex] != curFrame.inFlightFence)
+		{
+			vkWaitForFences(*device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		}
+		imagesInFlight[imageIndex] = curFrame.inFlightFence;
 
-		FrameInfo info = {};
+		info = {};
 
 		info.time = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()).time_since_epoch().count();
 		
@@ -247,7 +309,7 @@ namespace Renderer
 		info.imageIndex = imageIndex;
 		info.imageView = images[imageIndex]->GetView();
 
-		return info;
+		return VK_SUCCESS;
 	}
 
 	VkResult Swapchain::EndFrame(FrameInfo& info, VkQueue graphicsQueue)
@@ -260,17 +322,23 @@ namespace Renderer
 
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.waitSemaphoreCount = headless ? 0 : 1;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &frame.buffer;
-		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.signalSemaphoreCount = headless ? 0 : 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
 		auto success = vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlightFence);
 		Assert(success == VK_SUCCESS, "Failed to submit queue");
 
+		if (headless)
+		{
+			++currentIndex %= framesInFlight;
+			return success;
+		}
+
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
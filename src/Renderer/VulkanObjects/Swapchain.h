@@ -10,6 +10,7 @@ struct GLFWwindow;
 
 namespace Renderer
 {
+	namespace Memory { class Allocator; }
 	class Core;
 	class PassDesc;
 	
@@ -49,6 +50,7 @@ namespace Renderer
 		VkSwapchainKHR swapchain = nullptr;
 		std::vector<Memory::Image*> images;
 		std::vector<FrameResources> frames;
+		std::vector<VkFence> imagesInFlight; // Fence of the frame slot last rendering to each image
 		VkQueue presentQueue;
 		VkQueue graphicsQueue;
 
@@ -62,7 +64,9 @@ namespace Renderer
 		long long prevTime = 0;
 		uint32_t frameCount = 0;
 		uint32_t currentIndex = 0;
-		uint32_t framesInFlight = 3;
+		uint32_t framesInFlight = 0; // 0 until set, then follows the image count
+		uint32_t imageCount = 0;
+		bool headless = false;
 
 		int width = 640;
 		int height = 400;
@@ -82,16 +86,31 @@ namespace Renderer
 		VkExtent2D GetExtent() { return extent; }
 		uint32_t GetIndex() { return currentIndex; }
 		uint32_t GetFramesInFlight() { return framesInFlight; }
+		uint32_t GetImageCount() { return imageCount; }
+		bool IsHeadless() const { return headless; }
+
+		// Layout the backbuffer has to be in at the end of a frame, offscreen images are left ready to be copied out
+		VkImageLayout GetPresentLayout() const { return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
 
 	public:
 
 		void Initialise(VkDevice* device, VkInstance* instance, VkPhysicalDevice* physDevice);
+		
+		// Number of frame slots the CPU can record ahead, independent of how many images the swapchain hands out. 0 matches the image count
+		void SetFramesInFlight(uint32_t count) { framesInFlight = count; }
 		void BuildWindow(int width, int height, const char* title);
 		void BuildSurface();
-		void BuildSwapchain(bool vsync = false);
+		// Frames still in flight keep using the old images, when an allocator is given they're retired through it instead of destroyed straight away
+		void BuildSwapchain(bool vsync = false, Memory::Allocator* allocator = nullptr);
+		void SetSize(int width, int height) { this->width = width; this->height = height; }
 		void BuildSyncObjects();
 
-		FrameInfo BeginFrame(VkCommandBuffer buffer);
+		// Replaces the window, surface and swapchain with a ring of allocator owned images
+		void BuildHeadless(Memory::Allocator* allocator, int width, int height);
+		void DestroyHeadless();
+
+		// VK_ERROR_OUT_OF_DATE_KHR leaves the frame slot untouched, the swapchain has to be rebuilt before trying again
+		VkResult BeginFrame(VkCommandBuffer buffer, FrameInfo& info);
 		VkResult EndFrame(FrameInfo& info, VkQueue graphicsQueue);
 
 	private:
@@ -0,0 +1,58 @@
+#include "UniformStream.h"
+#include "../Memory/Allocator.h"
+#include "../Memory/Buffer.h"
+#include "../../Utils/Logging.h"
+#include <cstring>
+
+namespace Renderer
+{
+	void UniformStream::Initialise(Memory::Allocator* allocator, VkDeviceSize alignment, VkDeviceSize frameSize, uint32_t framesInFlight)
+	{
+		this->alignment = alignment;
+		this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+
+		// Coherent, nothing streamed is ever flushed
+		buffer = allocator->AllocateBuffer(this->frameSize * framesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		mapped = buffer->Map();
+
+		frameStart = 0;
+		head = 0;
+	}
+
+	void UniformStream::Destroy()
+	{
+		if (buffer == nullptr) return;
+
+		buffer->Unmap();
+		delete buffer;
+
+		buffer = nullptr;
+		mapped = nullptr;
+	}
+
+	VkBuffer UniformStream::GetBuffer() const { return buffer->GetResourceHandle(); }
+
+	std::pair<void*, uint32_t> UniformStream::Allocate(size_t size)
+	{
+		const auto offset = frameStart + head;
+		head += (size + alignment - 1) & ~(alignment - 1);
+
+		Assert(head <= frameSize, "Uniform stream is full, raise Settings::uniformStreamSize");
+
+		return { mapped + offset, static_cast<uint32_t>(offset) };
+	}
+
+	uint32_t UniformStream::Push(const void* data, size_t size)
+	{
+		const auto [dest, offset] = Allocate(size);
+		memcpy(dest, data, size);
+
+		return offset;
+	}
+
+	void UniformStream::BeginFrame(uint32_t frameOffset)
+	{
+		frameStart = frameSize * frameOffset;
+		head = 0;
+	}
+}
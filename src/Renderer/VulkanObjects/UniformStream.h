@@ -0,0 +1,45 @@
+#pragma once
+#include "vulkan.h"
+#include <cstdint>
+#include <utility>
+
+namespace Renderer
+{
+	namespace Memory
+	{
+		class Allocator;
+		class Buffer;
+	}
+
+	// One persistently mapped buffer split into a region per frame in flight. Uniform data is bump allocated from the
+	// current frame's region and reached through a dynamic offset, so a single descriptor covers every draw of every frame.
+	class UniformStream
+	{
+		Memory::Buffer* buffer = nullptr;
+		uint8_t* mapped = nullptr;
+
+		VkDeviceSize alignment = 256;
+		VkDeviceSize frameSize = 0;
+		VkDeviceSize frameStart = 0;
+		VkDeviceSize head = 0;
+
+	public:
+		UniformStream() = default;
+		UniformStream(const UniformStream&) = delete;
+		UniformStream& operator=(const UniformStream&) = delete;
+
+		// alignment is the device's minUniformBufferOffsetAlignment, frameSize the bytes one frame can stream
+		void Initialise(Memory::Allocator* allocator, VkDeviceSize alignment, VkDeviceSize frameSize, uint32_t framesInFlight);
+		void Destroy();
+
+		VkBuffer GetBuffer() const;
+		VkDeviceSize GetAlignment() const { return alignment; }
+
+		// Room for size bytes in this frame's region, and the dynamic offset to bind them with
+		std::pair<void*, uint32_t> Allocate(size_t size);
+		uint32_t Push(const void* data, size_t size);
+
+		// Once the fence for frameOffset has been waited on, everything streamed the last time round is free again
+		void BeginFrame(uint32_t frameOffset);
+	};
+}
@@ -119,6 +119,26 @@ namespace Renderer
 			core->GetAllocator()->DebugView();
 		}
 
+		if (ImGui::CollapsingHeader("Caches"))
+		{
+			const auto cacheRow = [](const char* name, const CacheStats& stats)
+			{
+				ImGui::Text("%s: %zu entries, %llu hits, %llu misses, %llu evicted", name, stats.size, static_cast<unsigned long long>(stats.hits),
+				            static_cast<unsigned long long>(stats.misses), static_cast<unsigned long long>(stats.evictions));
+			};
+
+			cacheRow("Graphics pipelines", core->GetGraphicsPipelineCache()->GetStats());
+			cacheRow("Compute pipelines", core->GetComputePipelineCache()->GetStats());
+			cacheRow("Renderpasses", core->GetRenderpassCache()->GetStats());
+			cacheRow("Framebuffers", core->GetFramebufferCache()->GetStats());
+			cacheRow("Descriptor sets", core->GetDescriptorSetCache()->GetStats());
+			cacheRow("Samplers", core->GetSamplerCache()->GetStats());
+
+			const auto& binds = core->GetDescriptorSetCache()->GetBindStats();
+			ImGui::Text("Binds last frame: %u frame, %u pass, %u material, %u draw", binds.binds[0], binds.binds[1], binds.binds[2], binds.binds[3]);
+			ImGui::Text("%u pushed, %u skipped", binds.pushes, binds.skipped);
+		}
+
 		ImGui::End();
 	}
 
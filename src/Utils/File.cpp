@@ -0,0 +1,28 @@
+#include "File.h"
+#include "Logging.h"
+#include <filesystem>
+#include <fstream>
+
+namespace Renderer
+{
+	bool WriteFileAtomically(const std::string& path, const char* data, size_t size, const char* what)
+	{
+		const auto tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				LogWarning("Failed to open {} for writing", what);
+				return false;
+			}
+
+			file.write(data, static_cast<std::streamsize>(size));
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		if (error) LogWarning("Failed to write {}", what);
+
+		return !error;
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+
+namespace Renderer
+{
+	// Writes data to a temporary next to path and renames it over path, so a crash half way through never leaves a
+	// truncated file behind. what names the file in warnings, false if anything failed
+	bool WriteFileAtomically(const std::string& path, const char* data, size_t size, const char* what);
+}